@@ -0,0 +1,324 @@
+//============================================================================
+// Name        : JpegBenchmark.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Compares cv::imencode with the JpegCompressor kept alive
+//               across frames, single threaded
+//
+// Build       : with OpenCV, using the include directories of the project:
+//                 -DHAVE_OPENCV benchmark/JpegBenchmark.cpp src/services/webcam/JpegCompressor.cpp
+//                 src/services/webcam/YuvImage.cpp, linked against OpenCV and libjpeg
+//               without OpenCV, libjpeg stand-ins for both sides:
+//                 g++ -O2 -std=c++14 benchmark/JpegBenchmark.cpp -ljpeg -o jpeg-benchmark
+// Usage       : jpeg-benchmark [quality] [frames]
+//============================================================================
+// With HAVE_OPENCV the real code paths are timed: cv::imencode against JpegCompressor::Encode
+// for BGR frames, and cvtColor to BGR plus cv::imencode against JpegCompressor::EncodeYUV for
+// I420 frames. Without OpenCV both sides are stand-ins written against libjpeg: a new
+// compressor with default tables, jpeg_mem_dest and a copy out per call, the sequence of
+// imencode, against one compressor whose tables stay allocated and which writes into a
+// reused vector, the sequence of JpegCompressor. Every run prints which of the two it times.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+#if defined(HAVE_OPENCV)
+#include "opencv2\core\core.hpp"
+#include "opencv2\imgcodecs.hpp"
+#include "opencv2\imgproc.hpp"
+#include "services/webcam/JpegCompressor.h"
+
+using services::webcam::JpegCompressor;
+#endif
+
+using std::vector;
+
+namespace {
+	const int DEFAULT_QUALITY = 85;
+	const int DEFAULT_FRAMES = 50;
+	const int SIZES[][2] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 } };
+
+	// moving gradients with some noise, compresses roughly like a camera picture
+	void MakeFrame(int width, int height, int index, vector<unsigned char>& bgr) {
+		bgr.resize(static_cast<size_t>(width) * height * 3);
+		unsigned int noise = 12345u + index;
+		for (int y = 0; y < height; y++) {
+			unsigned char* row = bgr.data() + static_cast<size_t>(y) * width * 3;
+			for (int x = 0; x < width; x++) {
+				noise = noise * 1103515245u + 12345u;
+				int grain = static_cast<int>((noise >> 16) & 15) - 8;
+				int band = ((x + index * 4) / 40 + y / 40) & 1 ? 60 : 0;
+				row[3 * x] = static_cast<unsigned char>(std::min(255, std::max(0, (x * 255) / width + grain)));
+				row[3 * x + 1] = static_cast<unsigned char>(std::min(255, std::max(0, (y * 255) / height + band + grain)));
+				row[3 * x + 2] = static_cast<unsigned char>(std::min(255, std::max(0, ((x + y + index * 8) & 255) / 2 + 64 + grain)));
+			}
+		}
+	}
+
+	// ms per frame and bytes of the last frame
+	struct Timing {
+		double ms;
+		size_t bytes;
+	};
+
+	Timing Measure(int frames, const std::function<size_t(int)>& encode) {
+		encode(0); // warm up, first allocations
+		auto start = std::chrono::steady_clock::now();
+		size_t bytes = 0;
+		for (int i = 0; i < frames; i++) {
+			bytes = encode(i);
+		}
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		Timing timing = { elapsed / frames, bytes };
+		return timing;
+	}
+
+	void Print(const char* name, int width, int height, const Timing& baseline, const Timing& timing) {
+		printf("%4dx%-5d %-28s %8.2f ms %9zu bytes %+6.1f %%\n", width, height, name, timing.ms, timing.bytes,
+			(timing.ms / baseline.ms - 1) * 100);
+	}
+
+#if !defined(HAVE_OPENCV)
+	J_COLOR_SPACE BgrColorSpace() {
+#ifdef JCS_EXTENSIONS
+		return JCS_EXT_BGR;
+#else
+		return JCS_RGB;
+#endif
+	}
+
+	// what imencode does for every call
+	size_t EncodePerCall(const vector<unsigned char>& bgr, int width, int height, int quality, vector<unsigned char>& output) {
+		jpeg_compress_struct cinfo;
+		jpeg_error_mgr error;
+		cinfo.err = jpeg_std_error(&error);
+		jpeg_create_compress(&cinfo);
+		unsigned char* buffer = nullptr;
+		unsigned long size = 0;
+		jpeg_mem_dest(&cinfo, &buffer, &size);
+		cinfo.image_width = width;
+		cinfo.image_height = height;
+		cinfo.input_components = 3;
+		cinfo.in_color_space = BgrColorSpace();
+		jpeg_set_defaults(&cinfo);
+		jpeg_set_quality(&cinfo, quality, TRUE);
+		jpeg_start_compress(&cinfo, TRUE);
+		while (cinfo.next_scanline < cinfo.image_height) {
+			JSAMPROW row = const_cast<JSAMPROW>(bgr.data() + static_cast<size_t>(cinfo.next_scanline) * width * 3);
+			jpeg_write_scanlines(&cinfo, &row, 1);
+		}
+		jpeg_finish_compress(&cinfo);
+		jpeg_destroy_compress(&cinfo);
+		output.assign(buffer, buffer + size);
+		free(buffer);
+		return output.size();
+	}
+
+	// the libjpeg sequence of JpegCompressor, created once and reused for every frame
+	class ReusedCompressor {
+	public:
+		ReusedCompressor() : quality(0) {
+			cinfo.err = jpeg_std_error(&error);
+			jpeg_create_compress(&cinfo);
+			dest.init_destination = InitDestination;
+			dest.empty_output_buffer = GrowDestination;
+			dest.term_destination = TermDestination;
+			cinfo.dest = &dest;
+			cinfo.input_components = 3;
+			cinfo.in_color_space = JCS_YCbCr;
+			jpeg_set_defaults(&cinfo);
+		}
+
+		~ReusedCompressor() {
+			jpeg_destroy_compress(&cinfo);
+		}
+
+		size_t Encode(const vector<unsigned char>& bgr, int width, int height, int quality, vector<unsigned char>& output) {
+			Prepare(width, height, quality, false, output);
+			jpeg_start_compress(&cinfo, TRUE);
+			JSAMPROW rows[16];
+			while (cinfo.next_scanline < cinfo.image_height) {
+				int count = std::min(16, static_cast<int>(cinfo.image_height - cinfo.next_scanline));
+				for (int i = 0; i < count; i++) {
+					rows[i] = const_cast<JSAMPROW>(bgr.data() + static_cast<size_t>(cinfo.next_scanline + i) * width * 3);
+				}
+				jpeg_write_scanlines(&cinfo, rows, count);
+			}
+			jpeg_finish_compress(&cinfo);
+			return output.size();
+		}
+
+		// I420 through the raw data interface, the width a multiple of 16
+		size_t EncodeYUV(const vector<unsigned char>& yuv, int width, int height, int quality, vector<unsigned char>& output) {
+			const unsigned char* y = yuv.data();
+			const unsigned char* u = y + static_cast<size_t>(width) * height;
+			const unsigned char* v = u + static_cast<size_t>(width / 2) * (height / 2);
+			JSAMPROW yRows[16], uRows[8], vRows[8];
+			JSAMPARRAY planes[] = { yRows, uRows, vRows };
+			Prepare(width, height, quality, true, output);
+			jpeg_start_compress(&cinfo, TRUE);
+			for (int row = 0; row < height; row += 16) {
+				for (int i = 0; i < 16; i++) {
+					// rows below the picture repeat the last one, like JpegCompressor::EncodeYUV
+					yRows[i] = const_cast<JSAMPROW>(y + static_cast<size_t>(std::min(row + i, height - 1)) * width);
+				}
+				for (int i = 0; i < 8; i++) {
+					size_t r = static_cast<size_t>(std::min(row / 2 + i, height / 2 - 1));
+					uRows[i] = const_cast<JSAMPROW>(u + r * (width / 2));
+					vRows[i] = const_cast<JSAMPROW>(v + r * (width / 2));
+				}
+				jpeg_write_raw_data(&cinfo, planes, 16);
+			}
+			jpeg_finish_compress(&cinfo);
+			return output.size();
+		}
+	private:
+		struct Destination : jpeg_destination_mgr {
+			vector<unsigned char>* output;
+		};
+
+		static void InitDestination(j_compress_ptr cinfo) {
+			Destination* dest = static_cast<Destination*>(cinfo->dest);
+			dest->output->resize(std::max<size_t>(dest->output->capacity(), 64 * 1024));
+			dest->next_output_byte = dest->output->data();
+			dest->free_in_buffer = dest->output->size();
+		}
+
+		static boolean GrowDestination(j_compress_ptr cinfo) {
+			Destination* dest = static_cast<Destination*>(cinfo->dest);
+			size_t used = dest->output->size();
+			dest->output->resize(used * 2);
+			dest->next_output_byte = dest->output->data() + used;
+			dest->free_in_buffer = dest->output->size() - used;
+			return TRUE;
+		}
+
+		static void TermDestination(j_compress_ptr cinfo) {
+			Destination* dest = static_cast<Destination*>(cinfo->dest);
+			dest->output->resize(dest->output->size() - dest->free_in_buffer);
+		}
+
+		void Prepare(int width, int height, int quality, bool rawData, vector<unsigned char>& output) {
+			cinfo.image_width = width;
+			cinfo.image_height = height;
+			cinfo.raw_data_in = rawData ? TRUE : FALSE;
+			cinfo.in_color_space = rawData ? JCS_YCbCr : BgrColorSpace();
+			if (quality != this->quality) {
+				jpeg_set_quality(&cinfo, quality, TRUE);
+				this->quality = quality;
+			}
+			cinfo.comp_info[0].h_samp_factor = 2;
+			cinfo.comp_info[0].v_samp_factor = 2;
+			for (int i = 1; i < 3; i++) {
+				cinfo.comp_info[i].h_samp_factor = 1;
+				cinfo.comp_info[i].v_samp_factor = 1;
+			}
+			dest.output = &output;
+		}
+
+		jpeg_compress_struct cinfo;
+		jpeg_error_mgr error;
+		Destination dest;
+		int quality;
+	};
+
+	// BT.601 full range like libjpeg, chroma of each 2x2 block averaged
+	void ToI420(const vector<unsigned char>& bgr, int width, int height, vector<unsigned char>& yuv) {
+		yuv.assign(static_cast<size_t>(width) * height * 3 / 2, 0);
+		unsigned char* y = yuv.data();
+		unsigned char* u = y + static_cast<size_t>(width) * height;
+		unsigned char* v = u + static_cast<size_t>(width / 2) * (height / 2);
+		for (int r = 0; r < height; r++) {
+			for (int c = 0; c < width; c++) {
+				const unsigned char* p = bgr.data() + (static_cast<size_t>(r) * width + c) * 3;
+				double luma = 0.299 * p[2] + 0.587 * p[1] + 0.114 * p[0];
+				y[static_cast<size_t>(r) * width + c] = static_cast<unsigned char>(luma + 0.5);
+				if (r % 2 == 0 && c % 2 == 0) {
+					size_t i = static_cast<size_t>(r / 2) * (width / 2) + c / 2;
+					u[i] = static_cast<unsigned char>(std::min(255.0, std::max(0.0, 128 + 0.564 * (p[0] - luma))));
+					v[i] = static_cast<unsigned char>(std::min(255.0, std::max(0.0, 128 + 0.713 * (p[2] - luma))));
+				}
+			}
+		}
+	}
+#endif
+}
+
+int main(int argc, char** argv) {
+	int quality = argc > 1 ? atoi(argv[1]) : DEFAULT_QUALITY;
+	int frames = argc > 2 ? atoi(argv[2]) : DEFAULT_FRAMES;
+
+#if defined(HAVE_OPENCV)
+	printf("cv::imencode against JpegCompressor, OpenCV %s, quality %d, %d frames\n", CV_VERSION, quality, frames);
+#else
+	printf("libjpeg stand-ins for cv::imencode and JpegCompressor, libjpeg %d, quality %d, %d frames\n", JPEG_LIB_VERSION, quality, frames);
+#endif
+
+	for (auto& dimensions : SIZES) {
+		int width = dimensions[0];
+		int height = dimensions[1];
+		vector<vector<unsigned char>> pictures(4);
+		for (size_t i = 0; i < pictures.size(); i++) {
+			MakeFrame(width, height, static_cast<int>(i), pictures[i]);
+		}
+		vector<unsigned char> output;
+
+#if defined(HAVE_OPENCV)
+		vector<cv::Mat> bgr, yuv(pictures.size());
+		for (size_t i = 0; i < pictures.size(); i++) {
+			bgr.push_back(cv::Mat(height, width, CV_8UC3, pictures[i].data()));
+			cv::cvtColor(bgr[i], yuv[i], cv::COLOR_BGR2YUV_I420);
+		}
+		const vector<int> parameters = { cv::IMWRITE_JPEG_QUALITY, quality };
+		JpegCompressor compressor;
+		cv::Mat converted;
+
+		Timing imencode = Measure(frames, [&](int i) {
+			cv::imencode(".jpg", bgr[i % bgr.size()], output, parameters);
+			return output.size();
+		});
+		Print("cv::imencode BGR", width, height, imencode, imencode);
+		Print("JpegCompressor::Encode", width, height, imencode, Measure(frames, [&](int i) {
+			compressor.Encode(bgr[i % bgr.size()], quality, output);
+			return output.size();
+		}));
+
+		Timing convert = Measure(frames, [&](int i) {
+			cv::cvtColor(yuv[i % yuv.size()], converted, cv::COLOR_YUV2BGR_I420);
+			cv::imencode(".jpg", converted, output, parameters);
+			return output.size();
+		});
+		Print("I420 to BGR + cv::imencode", width, height, convert, convert);
+		Print("JpegCompressor::EncodeYUV", width, height, convert, Measure(frames, [&](int i) {
+			compressor.EncodeYUV(yuv[i % yuv.size()], cv::Range(0, height), quality, output);
+			return output.size();
+		}));
+#else
+		vector<vector<unsigned char>> yuv(pictures.size());
+		for (size_t i = 0; i < pictures.size(); i++) {
+			ToI420(pictures[i], width, height, yuv[i]);
+		}
+		ReusedCompressor compressor;
+
+		Timing perCall = Measure(frames, [&](int i) {
+			return EncodePerCall(pictures[i % pictures.size()], width, height, quality, output);
+		});
+		Print("stand-in imencode BGR", width, height, perCall, perCall);
+		Print("stand-in reused BGR", width, height, perCall, Measure(frames, [&](int i) {
+			return compressor.Encode(pictures[i % pictures.size()], width, height, quality, output);
+		}));
+		Print("stand-in reused I420", width, height, perCall, Measure(frames, [&](int i) {
+			return compressor.EncodeYUV(yuv[i % yuv.size()], width, height, quality, output);
+		}));
+#endif
+	}
+	return 0;
+}
@@ -0,0 +1,308 @@
+//============================================================================
+// Name        : SpliceBenchmark.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Compares the write and splice transports of MjpegBroadcaster
+//               over loopback viewers, Linux only
+//
+// Build       : g++ -O2 -std=c++14 -pthread benchmark/SpliceBenchmark.cpp -o splice-benchmark
+// Usage       : splice-benchmark [frame bytes] [viewers...]
+//============================================================================
+// Mirrors MjpegPart::Send() and MjpegSession::WriteParts() with plain system calls, so it
+// runs without Poco: write sends header, payload and trailer with one sendmsg per viewer,
+// splice fills a fresh pipe once per frame with writev, then tee()s it into a pipe per viewer
+// and splice()s that into the socket. One sender thread serves all non-blocking sockets like
+// a reactor thread, one receiver thread drains them. Only the sender's CPU time is reported.
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace {
+	const size_t DEFAULT_FRAME_SIZE = 150 * 1024; //in bytes, a 1280x720 frame at quality 80
+	const size_t TOTAL_BYTES = static_cast<size_t>(2) << 30; //in bytes sent per run over all viewers
+	const int MIN_FRAMES = 20;
+	const char TRAILER[] = "\r\n\r\n";
+
+	struct Result {
+		double cpuPerViewer;   // us of sender CPU per viewer and frame
+		double throughput;     // MB/s over all viewers
+		double partsPerViewer; // frames per second each viewer received
+	};
+
+	void Check(bool ok, const char* what) {
+		if (!ok) {
+			throw std::runtime_error(string(what) + ": " + strerror(errno));
+		}
+	}
+
+	double ThreadCpu() {
+		timespec time;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+		return time.tv_sec * 1e6 + time.tv_nsec / 1e3;
+	}
+
+	// pairs of connected loopback sockets, the sending ends non-blocking like the broadcaster's
+	void Connect(int viewers, vector<int>& senders, vector<int>& receivers) {
+		int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+		Check(listener >= 0, "socket");
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		Check(::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0, "bind");
+		Check(::listen(listener, viewers) == 0, "listen");
+		socklen_t length = sizeof(address);
+		Check(::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) == 0, "getsockname");
+
+		for (int i = 0; i < viewers; i++) {
+			int receiver = ::socket(AF_INET, SOCK_STREAM, 0);
+			Check(receiver >= 0 && ::connect(receiver, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0, "connect");
+			int sender = ::accept(listener, nullptr, nullptr);
+			Check(sender >= 0, "accept");
+			::fcntl(sender, F_SETFL, O_NONBLOCK);
+			int one = 1;
+			::setsockopt(sender, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			senders.push_back(sender);
+			receivers.push_back(receiver);
+		}
+		::close(listener);
+	}
+
+	// discards everything the viewers get until expected bytes arrived
+	void Drain(const vector<int>& receivers, size_t expected) {
+		int poller = ::epoll_create1(0);
+		for (int fd : receivers) {
+			epoll_event event = {};
+			event.events = EPOLLIN;
+			event.data.fd = fd;
+			::epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event);
+		}
+		vector<epoll_event> events(receivers.size());
+		size_t received = 0;
+		while (received < expected) {
+			int ready = ::epoll_wait(poller, events.data(), static_cast<int>(events.size()), 1000);
+			for (int i = 0; i < ready; i++) {
+				// MSG_TRUNC discards TCP data without copying it out
+				ssize_t bytes = ::recv(events[i].data.fd, nullptr, 1 << 20, MSG_TRUNC | MSG_DONTWAIT);
+				if (bytes > 0) {
+					received += static_cast<size_t>(bytes);
+				}
+			}
+		}
+		::close(poller);
+	}
+
+	// one part to every viewer, returns once all of them took it completely
+	void SendWrite(const vector<int>& senders, const string& header, const vector<char>& payload) {
+		size_t size = header.size() + payload.size() + sizeof(TRAILER) - 1;
+		vector<size_t> offsets(senders.size(), 0);
+		vector<pollfd> pending;
+		size_t done = 0;
+		while (done < senders.size()) {
+			for (size_t i = 0; i < senders.size(); i++) {
+				while (offsets[i] < size) {
+					const char* segments[3] = { header.data(), payload.data(), TRAILER };
+					const size_t lengths[3] = { header.size(), payload.size(), sizeof(TRAILER) - 1 };
+					iovec buffers[3];
+					int count = 0;
+					size_t offset = offsets[i];
+					for (int s = 0; s < 3; s++) {
+						if (offset >= lengths[s]) {
+							offset -= lengths[s];
+							continue;
+						}
+						buffers[count].iov_base = const_cast<char*>(segments[s] + offset);
+						buffers[count++].iov_len = lengths[s] - offset;
+						offset = 0;
+					}
+					msghdr message = {};
+					message.msg_iov = buffers;
+					message.msg_iovlen = count;
+					ssize_t sent = ::sendmsg(senders[i], &message, MSG_NOSIGNAL);
+					if (sent <= 0) {
+						Check(errno == EAGAIN || errno == EWOULDBLOCK, "sendmsg");
+						break;
+					}
+					offsets[i] += static_cast<size_t>(sent);
+					if (offsets[i] == size) {
+						++done;
+					}
+				}
+			}
+			if (done < senders.size()) {
+				pending.clear();
+				for (size_t i = 0; i < senders.size(); i++) {
+					if (offsets[i] < size) {
+						pending.push_back({ senders[i], POLLOUT, 0 });
+					}
+				}
+				::poll(pending.data(), pending.size(), 1000);
+			}
+		}
+	}
+
+	struct Pipe {
+		Pipe() : read(-1), write(-1) { }
+		~Pipe() { Close(); }
+
+		void Open(size_t capacity) {
+			int fds[2];
+			Check(::pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0, "pipe2");
+			read = fds[0];
+			write = fds[1];
+			Check(::fcntl(write, F_SETPIPE_SZ, static_cast<int>(capacity)) >= static_cast<int>(capacity), "F_SETPIPE_SZ");
+		}
+
+		void Close() {
+			if (read >= 0) {
+				::close(read);
+				::close(write);
+			}
+			read = write = -1;
+		}
+
+		int read;
+		int write;
+	};
+
+	// like MjpegPart with prepareSplice: a new shared pipe per part, filled once
+	void SendSplice(const vector<int>& senders, vector<Pipe>& viewerPipes, const string& header, const vector<char>& payload) {
+		size_t size = header.size() + payload.size() + sizeof(TRAILER) - 1;
+		Pipe shared;
+		shared.Open(size);
+		iovec buffers[3] = {
+			{ const_cast<char*>(header.data()), header.size() },
+			{ const_cast<char*>(payload.data()), payload.size() },
+			{ const_cast<char*>(TRAILER), sizeof(TRAILER) - 1 }
+		};
+		Check(::writev(shared.write, buffers, 3) == static_cast<ssize_t>(size), "writev");
+
+		vector<size_t> remaining(senders.size());
+		for (size_t i = 0; i < senders.size(); i++) {
+			// the viewer pipes are empty and large enough, so the tee is never partial here
+			Check(::tee(shared.read, viewerPipes[i].write, size, SPLICE_F_NONBLOCK) == static_cast<ssize_t>(size), "tee");
+			remaining[i] = size;
+		}
+
+		vector<pollfd> pending;
+		size_t done = 0;
+		while (done < senders.size()) {
+			for (size_t i = 0; i < senders.size(); i++) {
+				while (remaining[i] > 0) {
+					ssize_t moved = ::splice(viewerPipes[i].read, nullptr, senders[i], nullptr, remaining[i], SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+					if (moved <= 0) {
+						Check(errno == EAGAIN || errno == EWOULDBLOCK, "splice");
+						break;
+					}
+					remaining[i] -= static_cast<size_t>(moved);
+					if (remaining[i] == 0) {
+						++done;
+					}
+				}
+			}
+			if (done < senders.size()) {
+				pending.clear();
+				for (size_t i = 0; i < senders.size(); i++) {
+					if (remaining[i] > 0) {
+						pending.push_back({ senders[i], POLLOUT, 0 });
+					}
+				}
+				::poll(pending.data(), pending.size(), 1000);
+			}
+		}
+	}
+
+	Result Run(bool splice, int viewers, size_t frameSize) {
+		vector<int> senders, receivers;
+		Connect(viewers, senders, receivers);
+
+		vector<char> payload(frameSize);
+		for (size_t i = 0; i < payload.size(); i++) {
+			payload[i] = static_cast<char>(rand());
+		}
+		string header = "--boundary\r\nContent-Length: " + std::to_string(frameSize) + "\r\nContent-Type: image/jpeg\r\n\r\n";
+		size_t partSize = header.size() + frameSize + sizeof(TRAILER) - 1;
+		int frames = std::max(MIN_FRAMES, static_cast<int>(TOTAL_BYTES / (partSize * viewers)));
+
+		vector<Pipe> viewerPipes(splice ? viewers : 0);
+		for (auto& pipe : viewerPipes) {
+			pipe.Open(partSize);
+		}
+
+		std::thread receiver(Drain, std::cref(receivers), partSize * viewers * frames);
+		auto start = std::chrono::steady_clock::now();
+		double cpuStart = ThreadCpu();
+		for (int frame = 0; frame < frames; frame++) {
+			if (splice) {
+				SendSplice(senders, viewerPipes, header, payload);
+			}
+			else {
+				SendWrite(senders, header, payload);
+			}
+		}
+		double cpu = ThreadCpu() - cpuStart;
+		receiver.join();
+		double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		viewerPipes.clear();
+		for (size_t i = 0; i < senders.size(); i++) {
+			::close(senders[i]);
+			::close(receivers[i]);
+		}
+
+		Result result;
+		result.cpuPerViewer = cpu / (static_cast<double>(frames) * viewers);
+		result.throughput = partSize * static_cast<double>(frames) * viewers / wall / 1e6;
+		result.partsPerViewer = frames / wall;
+		return result;
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t frameSize = argc > 1 ? static_cast<size_t>(atol(argv[1])) : DEFAULT_FRAME_SIZE;
+	vector<int> counts;
+	for (int i = 2; i < argc; i++) {
+		counts.push_back(atoi(argv[i]));
+	}
+	if (counts.empty()) {
+		counts = { 1, 10, 100 };
+	}
+
+	printf("frame %zu bytes, %u cores\n", frameSize, std::thread::hardware_concurrency());
+	printf("%8s %10s %16s %12s %14s\n", "viewers", "transport", "cpu us/viewer", "MB/s", "fps/viewer");
+	try {
+		for (int viewers : counts) {
+			for (bool splice : { false, true }) {
+				Result result = Run(splice, viewers, frameSize);
+				printf("%8d %10s %16.1f %12.0f %14.1f\n", viewers, splice ? "splice" : "write",
+					result.cpuPerViewer, result.throughput, result.partsPerViewer);
+				fflush(stdout);
+			}
+		}
+	}
+	catch (std::exception& e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -5,6 +5,7 @@
 #include "Poco/Net/HTTPServer.h"
 #include "Poco/Util/Subsystem.h"
 #include "services/webcam/WebcamService.h"
+#include "Network/router/MjpegBroadcaster.h"
 using services::webcam::WebcamService;
 
 namespace LiveStream{
@@ -25,8 +26,18 @@ public:
 	const char* name() const;
 
 private:
+	services::webcam::FrameSource::Ptr createFrameSource(Poco::Util::Application& app);
+		/// Creates the frame source selected by the webcam.source setting
+		/// ("camera", "synthetic" or "replay").
+
+	std::vector<services::webcam::Rendition> createRenditions(Poco::Util::Application& app);
+		/// Creates the encoding ladder listed in webcam.renditions. Known names
+		/// ("full", "720p", "360p", "thumbnail") come with defaults that
+		/// webcam.rendition.<name>.* settings override.
+
     Poco::AutoPtr<Poco::Net::HTTPServerParams> _httpServerParams;
 	Poco::SharedPtr<WebcamService> _webcamService;
+	Poco::SharedPtr<infrastructure::video_streaming::MjpegBroadcaster> _broadcaster;
 	Poco::AutoPtr<WebServerDispatcher> _webServerDispatcher;
 	
 	Poco::Net::HTTPServer * _httpServer;
@@ -0,0 +1,56 @@
+//============================================================================
+// Name        : FrameRequestHandlerFactory.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Single encoded frames by sequence under /api/webcam/frame, with long polling
+//============================================================================
+#pragma once
+#include "../../services/webcam/WebcamService.h"
+#include "Poco\Net\HTTPRequestHandlerFactory.h"
+#include "Poco\Net\HTTPRequestHandler.h"
+#include "Poco\Net\HTTPServerRequest.h"
+#include "Poco\Net\HTTPServerResponse.h"
+#include "Poco\SharedPtr.h"
+
+using Poco::Net::HTTPRequestHandlerFactory;
+using Poco::Net::HTTPRequestHandler;
+using Poco::Net::HTTPServerRequest;
+using Poco::Net::HTTPServerResponse;
+using Poco::SharedPtr;
+using services::webcam::WebcamService;
+
+namespace infrastructure {
+	namespace video_streaming {
+		class FrameRequestHandlerFactory : public HTTPRequestHandlerFactory
+		{
+		public:
+			struct Config {
+				Config() : maxWait(10000), hold(5000) { }
+
+				long maxWait;        // ms a request may wait for the next frame, also the default
+				long hold;           // ms a rendition stays encoded after a poll, bridges the gap to the next one
+			};
+
+			FrameRequestHandlerFactory(SharedPtr<WebcamService> webcamService, const Config& config);
+			~FrameRequestHandlerFactory();
+			HTTPRequestHandler* createRequestHandler(const HTTPServerRequest& request);
+		private:
+			SharedPtr<WebcamService> webcamService;
+			const Config config;
+		};
+
+		// GET /api/webcam/frame?after=<sequence> answers with the frame following sequence as
+		// image/jpeg, at once if it was already encoded, otherwise as soon as it is. Clients pass
+		// the X-Frame-Sequence of the last answer to get every frame exactly once.
+		class FrameRequestHandler : public HTTPRequestHandler
+		{
+		public:
+			FrameRequestHandler(SharedPtr<WebcamService> webcamService, const FrameRequestHandlerFactory::Config& config);
+			~FrameRequestHandler();
+			void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response);
+		private:
+			SharedPtr<WebcamService> webcamService;
+			const FrameRequestHandlerFactory::Config config;
+		};
+	}
+}
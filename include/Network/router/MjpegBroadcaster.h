@@ -0,0 +1,146 @@
+//============================================================================
+// Name        : MjpegBroadcaster.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Fans encoded frames out to all MJPEG viewers using a few
+//               SocketReactor threads instead of one thread per viewer
+//============================================================================
+#pragma once
+#include "../../services/webcam/WebcamService.h"
+#include "MjpegSession.h"
+#include "../../shared/timer/TimerWheel.h"
+#include "Poco\Net\ParallelSocketReactor.h"
+#include "Poco\Thread.h"
+#include "Poco\RunnableAdapter.h"
+#include "Poco\SharedPtr.h"
+#include "Poco\Mutex.h"
+#include "Poco\Event.h"
+
+#include <atomic>
+#include <vector>
+
+using std::vector;
+using Poco::SharedPtr;
+using services::webcam::WebcamService;
+using services::webcam::StageStats;
+
+namespace infrastructure {
+	namespace video_streaming {
+		class MjpegBroadcaster {
+		public:
+			enum Transport {
+				TRANSPORT_WRITE,   // sendmsg from the shared part buffers
+				TRANSPORT_SPLICE   // tee()/splice() from a pipe filled once per frame, Linux only
+			};
+
+			struct Config {
+				Config() : reactors(2), transport(TRANSPORT_WRITE), adaptive(true), burst(1), pacingTick(5) { }
+
+				int reactors;                  // number of reactor threads serving sockets
+				Transport transport;           // how parts are moved into the sockets
+				bool adaptive;                 // default for viewers that do not pass ?adaptive=
+				int burst;                     // recent frames written to a new viewer right after the headers, 0 = wait for the next one
+				int pacingTick;                // ms, resolution of the timer wheel that paces viewers with a frame rate cap
+				MjpegSession::Config session;  // per viewer queueing and eviction settings
+			};
+
+			MjpegBroadcaster(SharedPtr<WebcamService> webcamService, const Config& config);
+			~MjpegBroadcaster();
+
+			void Start();
+			void Stop();
+
+			// takes over a socket whose HTTP response headers were already sent and writes the
+			// latest frames of the rendition at once, so the viewer sees a picture immediately.
+			// Adaptive viewers move down the ladder from rendition and back up to it to match their
+			// throughput, and skip frames their connection cannot carry. requested is when the
+			// request arrived, the start of the time to first frame. With fps > 0 the viewer gets at most
+			// that many frames per second, evenly spaced on a timer wheel shared by all such viewers.
+			void AddClient(const StreamSocket& socket, int rendition, bool adaptive, double fps, const Poco::Timestamp& requested);
+			size_t GetClientCount();
+			// viewers with a frame rate cap
+			size_t GetPacedClientCount();
+			// time from a viewer's request until its first frame was written
+			StageStats& GetFirstFrameStats();
+			const string& GetBoundary() const;
+			bool IsAdaptive() const;
+
+			// maps "write" or "splice" to a transport, unknown names select write
+			static Transport ParseTransport(const string& name);
+		private:
+			typedef Poco::Net::ParallelSocketReactor<SocketReactor> Reactor;
+
+			MjpegBroadcaster(const MjpegBroadcaster&);
+			MjpegBroadcaster& operator=(const MjpegBroadcaster&);
+
+			// state of a viewer with a frame rate cap, shared with its timer in the wheel
+			struct Pacing {
+				MjpegSession::Ptr session;
+				int rendition;              // follows the viewer across rendition switches
+				Poco::Timestamp::TimeDiff interval;
+				Poco::Timestamp due;        // next send on the viewer's even grid
+				MjpegPart::Ptr lastSent;
+				bool closed;                // the viewer is gone, the timer is dropped when it fires
+			};
+
+			struct Viewer {
+				MjpegSession::Ptr session;
+				int ceiling;                // rendition the client asked for, never exceeded
+				bool adaptive;
+				Poco::Timestamp lastSwitch;
+				Poco::Timestamp lastCheck;
+				Poco::UInt64 lastLost;      // dropped and expired frames at lastCheck
+				Poco::Timestamp nextDue;    // frames offered earlier are skipped
+				bool firstFrameSeen;        // the time to first frame was recorded
+				SharedPtr<Pacing> pacing;   // only set for viewers with a frame rate cap
+			};
+
+			// frame size and rate of a rendition as seen by the broadcast thread
+			struct RenditionLoad {
+				RenditionLoad() : partBytes(0), partInterval(0) { }
+
+				double partBytes;
+				double partInterval;        // us between parts
+				Poco::Timestamp lastPart;
+			};
+
+			// waits for each new frame and hands it to every session without a frame rate cap
+			void BroadcastCore();
+			// advances the timer wheel and sends the latest part to each paced viewer that is due
+			void PacingCore();
+			// enqueues the latest part of the viewer's rendition unless it was sent already and moves
+			// the timer to the next slot of the grid. Caller holds sessionsMutex
+			void SendPaced(Pacing& pacing, const Poco::Timestamp& now);
+			// bytes per second a viewer of the rendition has to take, 0 while unknown
+			double GetRequiredThroughput(int rendition);
+			// rendition the viewer should be moved to, rendition if it stays. Caller holds sessionsMutex
+			int Adapt(Viewer& viewer, int rendition);
+			// enqueues the part unless the viewer is still busy with the bandwidth of earlier ones.
+			// Caller holds sessionsMutex
+			void Offer(Viewer& viewer, MjpegPart::Ptr part);
+			// the last config.burst frames of the rendition that are still fresh, oldest first. Falls back to
+			// the last part of the nearest other rendition if the rendition has none. Caller holds sessionsMutex
+			vector<MjpegPart::Ptr> GetRecentParts(int rendition);
+			// records the time to first frame once the session wrote it. Caller holds sessionsMutex
+			void CheckFirstFrame(Viewer& viewer);
+
+			SharedPtr<WebcamService> webcamService;
+			const Config config;
+			bool useSplice;                // splice was requested and is supported here
+			vector<SharedPtr<Reactor>> reactors;
+			size_t nextReactor;
+			vector<vector<Viewer>> sessions;            // per rendition, guarded by sessionsMutex
+			vector<MjpegPart::Ptr> lastParts;           // per rendition, last part handed to the sessions
+			vector<RenditionLoad> loads;                // per rendition, only used by the broadcast thread
+			Poco::FastMutex sessionsMutex;
+			StageStats firstFrameStats;
+			TimerWheel<SharedPtr<Pacing>> pacingWheel;  // guarded by sessionsMutex
+			Poco::Event pacingWake;                     // set when the wheel gets its first timer
+			std::atomic<bool> isRunning;
+			Poco::Thread broadcastThread;
+			Poco::RunnableAdapter<MjpegBroadcaster> broadcastAdapter;
+			Poco::Thread pacingThread;
+			Poco::RunnableAdapter<MjpegBroadcaster> pacingAdapter;
+		};
+	}
+}
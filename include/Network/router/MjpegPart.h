@@ -0,0 +1,80 @@
+//============================================================================
+// Name        : MjpegPart.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Multipart part of one encoded frame, serialized once and
+//               shared by all viewers
+//============================================================================
+#pragma once
+#include "../../services/webcam/EncodedFrame.h"
+#include "SplicePipe.h"
+#include "Poco\Net\StreamSocket.h"
+#include "Poco\RefCountedObject.h"
+#include "Poco\AutoPtr.h"
+#include "Poco\SharedPtr.h"
+
+#include <string>
+
+using std::string;
+using Poco::Net::StreamSocket;
+using services::webcam::EncodedFrame;
+
+namespace infrastructure {
+	namespace video_streaming {
+		// Wire layout: [boundary and part headers][JPEG payload][trailer].
+		// The payload is not copied, the part keeps a reference to the frame.
+		class MjpegPart : public Poco::RefCountedObject {
+		public:
+			typedef Poco::AutoPtr<MjpegPart> Ptr;
+
+			// with prepareSplice the serialized part is also written once into a pipe that
+			// sessions tee() from. Falls back silently if the part does not fit into a pipe.
+			MjpegPart(EncodedFrame::Ptr frame, const string& boundary, bool prepareSplice = false);
+
+			EncodedFrame::Ptr GetFrame() const;
+			const string& GetHeader() const;
+			// total number of bytes on the wire
+			size_t GetSize() const;
+
+			// writes the bytes starting at offset with a single scatter-gather call on a
+			// non-blocking socket. Returns the number of bytes written, 0 if the socket
+			// would block. Throws a Poco::Net::NetException if the connection failed.
+			int Send(StreamSocket& socket, size_t offset) const;
+
+			// pipe holding the complete part, null if the part was not prepared for splicing
+			const SplicePipe* GetPipe() const;
+		protected:
+			~MjpegPart();
+		private:
+			MjpegPart(const MjpegPart&);
+			MjpegPart& operator=(const MjpegPart&);
+
+			// fills up to three buffers covering the bytes from offset to the end, returns the count
+			int GetBuffers(size_t offset, Poco::Net::SocketBuf* buffers) const;
+
+			const EncodedFrame::Ptr frame;
+			const string header;
+			const size_t size;
+			Poco::SharedPtr<SplicePipe> pipe;
+		};
+
+		//
+		// inlines
+		//
+		inline EncodedFrame::Ptr MjpegPart::GetFrame() const {
+			return frame;
+		}
+
+		inline const string& MjpegPart::GetHeader() const {
+			return header;
+		}
+
+		inline size_t MjpegPart::GetSize() const {
+			return size;
+		}
+
+		inline const SplicePipe* MjpegPart::GetPipe() const {
+			return pipe.get();
+		}
+	}
+}
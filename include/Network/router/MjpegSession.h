@@ -0,0 +1,131 @@
+//============================================================================
+// Name        : MjpegSession.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : One MJPEG viewer served by a SocketReactor with a non-blocking socket
+//============================================================================
+#pragma once
+#include "MjpegPart.h"
+#include "SplicePipe.h"
+#include "Poco\Net\SocketReactor.h"
+#include "Poco\Net\SocketNotification.h"
+#include "Poco\Net\StreamSocket.h"
+#include "Poco\Net\SocketAddress.h"
+#include "Poco\RefCountedObject.h"
+#include "Poco\AutoPtr.h"
+#include "Poco\Mutex.h"
+#include "Poco\Timestamp.h"
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using Poco::Net::SocketReactor;
+using Poco::Net::StreamSocket;
+using Poco::Net::SocketAddress;
+using Poco::Net::ReadableNotification;
+using Poco::Net::WritableNotification;
+using Poco::Net::ErrorNotification;
+
+namespace infrastructure {
+	namespace video_streaming {
+		// Sends multipart parts to a single client. Frames are handed in by the
+		// broadcaster thread, all socket I/O happens on the reactor thread.
+		class MjpegSession : public Poco::RefCountedObject {
+		public:
+			typedef Poco::AutoPtr<MjpegSession> Ptr;
+
+			struct Config {
+				Config() : boundary("VIDEOSTREAM"), queueSize(2), maxFrameAge(1000), evictAfter(10000) { }
+
+				string boundary;     // multipart boundary, used by the broadcaster when serializing parts
+				int queueSize;       // frames waiting behind the one being written, the oldest is dropped when full
+				int maxFrameAge;     // ms since capture after which a queued frame is skipped, 0 disables the cutoff
+				int evictAfter;      // ms a client may stay behind before it is disconnected, 0 never evicts
+			};
+
+			struct Stats {
+				Poco::UInt64 sent;       // frames completely written
+				Poco::UInt64 dropped;    // frames replaced by newer ones while queued
+				Poco::UInt64 expired;    // frames skipped because they exceeded maxFrameAge
+				Poco::UInt64 skipped;    // frames not offered because the measured throughput could not carry them
+				bool evicted;            // disconnected for staying behind
+				Poco::UInt64 bytesWritten;  // bytes copied into the socket by sendmsg
+				Poco::UInt64 bytesSpliced;  // bytes moved into the socket by splice, never copied to user space
+				Poco::Timestamp::TimeDiff firstFrame; // us from the request until the first part was written, 0 before
+			};
+
+			// requested is when the client's request arrived, the start of the time to first frame
+			MjpegSession(const StreamSocket& socket, SocketReactor& reactor, const Config& config, const Poco::Timestamp& requested);
+
+			// registers the socket with the reactor, must be called once before Enqueue()
+			void Start();
+			// queues a frame for sending, dropping the oldest queued frame when the queue is full.
+			// Evicts the client if it has been behind for longer than evictAfter.
+			void Enqueue(MjpegPart::Ptr part);
+			// queues already published parts ahead of the live ones, oldest first, and writes as
+			// much as the socket takes right away on the calling thread. These parts neither count
+			// against queueSize nor expire with maxFrameAge. Called once, after Start().
+			void Prime(const vector<MjpegPart::Ptr>& parts);
+			// unregisters from the reactor and closes the socket, safe to call more than once
+			// and from any thread. Must not be called with the session mutex held.
+			void Close();
+			// true once Close() has completed, the broadcaster may drop its reference then
+			bool IsClosed();
+			// counts a frame the broadcaster did not offer to match the throughput
+			void Skip();
+			// delivered bytes per second, a moving average over completed parts measured from the
+			// moment a part became current until its last byte left. 0 before the first part.
+			double GetThroughput();
+
+			const SocketAddress& GetClientAddress() const;
+			Stats GetStats();
+		protected:
+			~MjpegSession();
+		private:
+			MjpegSession(const MjpegSession&);
+			MjpegSession& operator=(const MjpegSession&);
+
+			void OnReadable(const Poco::AutoPtr<ReadableNotification>& notification);
+			void OnWritable(const Poco::AutoPtr<WritableNotification>& notification);
+			void OnError(const Poco::AutoPtr<ErrorNotification>& notification);
+
+			// takes the next frame that is young enough from the queue into current, caller holds mutex
+			void NextFrame();
+			// writes current and the parts behind it until the socket would block, returns false
+			// if the connection failed. Caller holds mutex
+			bool WriteParts();
+			// duplicates the pipe of current into viewerPipe if the part was prepared for splicing,
+			// leaves pipeBytes at 0 to fall back to sendmsg. Caller holds mutex
+			void TeeCurrent();
+			// caller holds mutex
+			void SetWritable(bool enable);
+			// caller holds mutex
+			void RecordThroughput(size_t bytes, Poco::Timestamp::TimeDiff elapsed);
+
+			StreamSocket socket;
+			SocketReactor& reactor;
+			const SocketAddress clientAddress;
+			const Config config;
+			Poco::FastMutex mutex;
+			bool closed;                // set first, stops all further I/O
+			std::atomic<bool> finished; // set last, nothing touches the session afterwards
+			bool writable;              // writable handler registered with the reactor
+			MjpegPart::Ptr current;     // part being written
+			std::deque<MjpegPart::Ptr> pending; // parts waiting for current to finish, oldest first
+			size_t primed;              // parts at the front of pending that came from Prime()
+			const Poco::Timestamp requested;
+			size_t offset;              // bytes of current already written or teed into viewerPipe
+			SplicePipe viewerPipe;      // per client pipe the shared part pipe is teed into, opened on first use
+			size_t pipeBytes;           // bytes of current still waiting in viewerPipe
+			bool behind;                // frames were queued while busy and the queue has not drained since
+			Poco::Timestamp behindSince;
+			Poco::Timestamp partStarted; // when current became the part being written
+			double throughput;          // bytes per second
+			Stats stats;
+		};
+	}
+}
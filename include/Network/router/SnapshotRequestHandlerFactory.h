@@ -0,0 +1,65 @@
+//============================================================================
+// Name        : SnapshotRequestHandlerFactory.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Latest encoded frame as a still image under /api/webcam/snapshot.jpg
+//============================================================================
+#pragma once
+#include "../../services/webcam/WebcamService.h"
+#include "Poco\Net\HTTPRequestHandlerFactory.h"
+#include "Poco\Net\HTTPRequestHandler.h"
+#include "Poco\Net\HTTPServerRequest.h"
+#include "Poco\Net\HTTPServerResponse.h"
+#include "Poco\SharedPtr.h"
+
+#include <string>
+
+using std::string;
+using Poco::Net::HTTPRequestHandlerFactory;
+using Poco::Net::HTTPRequestHandler;
+using Poco::Net::HTTPServerRequest;
+using Poco::Net::HTTPServerResponse;
+using Poco::SharedPtr;
+using services::webcam::WebcamService;
+
+namespace infrastructure {
+	namespace video_streaming {
+		class SnapshotRequestHandlerFactory : public HTTPRequestHandlerFactory
+		{
+		public:
+			struct Config {
+				Config() : maxAge(1000), maxWait(2000), hold(5000) { }
+
+				long maxAge;         // ms, an older latest frame is not served, the next one is waited for
+				long maxWait;        // ms to wait for that frame before the older one is served anyway
+				long hold;           // ms a rendition stays encoded after a snapshot without viewers
+			};
+
+			SnapshotRequestHandlerFactory(SharedPtr<WebcamService> webcamService, const Config& config);
+			~SnapshotRequestHandlerFactory();
+			HTTPRequestHandler* createRequestHandler(const HTTPServerRequest& request);
+		private:
+			SharedPtr<WebcamService> webcamService;
+			const Config config;
+			const string instance; // part of every ETag, sequences start over with each run
+		};
+
+		// Answers with the latest frame of a rendition and a strong ETag naming its sequence.
+		// A request whose If-None-Match names that frame gets 304 without a body. All requests
+		// share the one encoded frame, so many monitoring clients cost little more than one.
+		class SnapshotRequestHandler : public HTTPRequestHandler
+		{
+		public:
+			SnapshotRequestHandler(SharedPtr<WebcamService> webcamService, const SnapshotRequestHandlerFactory::Config& config, const string& instance);
+			~SnapshotRequestHandler();
+			void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response);
+		private:
+			// true if the If-None-Match header lists etag or *
+			static bool IsMatch(const HTTPServerRequest& request, const string& etag);
+
+			SharedPtr<WebcamService> webcamService;
+			const SnapshotRequestHandlerFactory::Config config;
+			const string instance;
+		};
+	}
+}
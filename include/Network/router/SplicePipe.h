@@ -0,0 +1,50 @@
+//============================================================================
+// Name        : SplicePipe.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Linux pipe used to move multipart parts into sockets with
+//               tee()/splice() instead of copying them through user space
+//============================================================================
+#pragma once
+#include "Poco\Net\StreamSocket.h"
+#include "Poco\Net\SocketDefs.h"
+
+using Poco::Net::StreamSocket;
+
+namespace infrastructure {
+	namespace video_streaming {
+		// Only functional on Linux, IsSupported() returns false elsewhere and Open() fails.
+		class SplicePipe {
+		public:
+			SplicePipe();
+			~SplicePipe();
+
+			static bool IsSupported();
+
+			// creates a non-blocking pipe able to hold at least capacity bytes,
+			// returns false if the kernel refuses that size (see /proc/sys/fs/pipe-max-size)
+			bool Open(size_t capacity);
+			// grows an empty pipe to hold at least capacity bytes
+			bool Reserve(size_t capacity);
+			void Close();
+			bool IsOpen() const;
+			size_t GetCapacity() const;
+
+			// writes the buffers into the pipe once, returns false if they did not fit completely
+			bool Fill(const Poco::Net::SocketBuf* buffers, int count, size_t size);
+			// duplicates the first length bytes of source into this pipe without consuming them
+			// from source. Returns the bytes duplicated, 0 if this pipe is full.
+			int TeeFrom(const SplicePipe& source, size_t length);
+			// moves up to length bytes from the pipe into the socket. Returns the bytes moved,
+			// 0 if the socket would block. Throws a Poco::Net::NetException on connection errors.
+			int SpliceTo(StreamSocket& socket, size_t length);
+		private:
+			SplicePipe(const SplicePipe&);
+			SplicePipe& operator=(const SplicePipe&);
+
+			int readFd;
+			int writeFd;
+			size_t capacity;
+		};
+	}
+}
@@ -6,6 +6,7 @@
 //============================================================================
 #pragma once
 #include "../../services/webcam/WebcamService.h"
+#include "MjpegBroadcaster.h"
 #include "Poco\Net\HTTPRequestHandlerFactory.h"
 #include "Poco\Net\HTTPServerRequest.h"
 #include "Poco\SharedPtr.h"
@@ -34,22 +35,24 @@ namespace infrastructure {
 		class VideoStreamingRequestHandlerFactory : public HTTPRequestHandlerFactory
 		{
 		public:
-			VideoStreamingRequestHandlerFactory(SharedPtr<WebcamService> webcamService);
+			VideoStreamingRequestHandlerFactory(SharedPtr<WebcamService> webcamService, SharedPtr<MjpegBroadcaster> broadcaster);
 			~VideoStreamingRequestHandlerFactory();
 			HTTPRequestHandler* createRequestHandler(const HTTPServerRequest& request);
 		private:
 			SharedPtr<WebcamService> webcamService;
+			SharedPtr<MjpegBroadcaster> broadcaster;
 			string uri;
 		};
 
 		class VideoStreamingRequestHandler : public HTTPRequestHandler
 		{
 		public:
-			VideoStreamingRequestHandler(SharedPtr<WebcamService> webcamService);
+			VideoStreamingRequestHandler(SharedPtr<WebcamService> webcamService, SharedPtr<MjpegBroadcaster> broadcaster);
 			~VideoStreamingRequestHandler();
 			void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response);
 		private:
 			SharedPtr<WebcamService> webcamService;
+			SharedPtr<MjpegBroadcaster> broadcaster;
 			string boundary;
 		};
 	}
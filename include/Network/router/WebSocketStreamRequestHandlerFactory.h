@@ -0,0 +1,85 @@
+//============================================================================
+// Name        : WebSocketStreamRequestHandlerFactory.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Encoded frames as binary WebSocket messages under /api/webcam/ws,
+//               paced by acknowledgements of the client
+//============================================================================
+#pragma once
+#include "../../services/webcam/WebcamService.h"
+#include "Poco\Net\HTTPRequestHandlerFactory.h"
+#include "Poco\Net\HTTPRequestHandler.h"
+#include "Poco\Net\HTTPServerRequest.h"
+#include "Poco\Net\HTTPServerResponse.h"
+#include "Poco\Net\WebSocket.h"
+#include "Poco\SharedPtr.h"
+
+#include <atomic>
+
+using Poco::Net::HTTPRequestHandlerFactory;
+using Poco::Net::HTTPRequestHandler;
+using Poco::Net::HTTPServerRequest;
+using Poco::Net::HTTPServerResponse;
+using Poco::Net::WebSocket;
+using Poco::SharedPtr;
+using services::webcam::WebcamService;
+
+namespace infrastructure {
+	namespace video_streaming {
+		class WebSocketStreamRequestHandlerFactory : public HTTPRequestHandlerFactory
+		{
+		public:
+			struct Config {
+				Config() : window(2), maxWindow(16), ackTimeout(10000), maxClients(16) { }
+
+				int window;          // unacknowledged frames in flight per client, the default for ?window=
+				int maxWindow;       // upper bound for ?window=
+				long ackTimeout;     // ms a client with a full window may stay silent before it is disconnected
+				int maxClients;      // each client holds a server thread while connected
+			};
+
+			WebSocketStreamRequestHandlerFactory(SharedPtr<WebcamService> webcamService, const Config& config);
+			~WebSocketStreamRequestHandlerFactory();
+			HTTPRequestHandler* createRequestHandler(const HTTPServerRequest& request);
+		private:
+			SharedPtr<WebcamService> webcamService;
+			const Config config;
+			std::atomic<int> clients;
+		};
+
+		// Upgrades GET /api/webcam/ws to a WebSocket and sends every frame as one binary message:
+		// a HEADER_SIZE byte big endian header (version, rendition, header size, sequence, capture
+		// time in us since epoch) followed by the JPEG. The client acknowledges frames by sending
+		// the sequence of the last one it received, as text or as 8 byte big endian binary message.
+		// At most window frames are unacknowledged, the ones encoded meanwhile are skipped and the
+		// latest is sent as soon as an acknowledgement opens the window.
+		class WebSocketStreamRequestHandler : public HTTPRequestHandler
+		{
+		public:
+			static const int HEADER_SIZE = 20;
+			static const int VERSION = 1;
+
+			WebSocketStreamRequestHandler(SharedPtr<WebcamService> webcamService, const WebSocketStreamRequestHandlerFactory::Config& config,
+				std::atomic<int>& clients);
+			~WebSocketStreamRequestHandler();
+			void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response);
+		private:
+			struct Stats {
+				Stats() : frames(0), skipped(0), bytes(0), acks(0), roundTrip(0) { }
+
+				Poco::UInt64 frames;
+				Poco::UInt64 skipped;
+				Poco::UInt64 bytes;
+				Poco::UInt64 acks;
+				Poco::Timestamp::TimeDiff roundTrip;  // us from sending a frame until its acknowledgement, summed
+			};
+
+			// streams until the client closes, stops acknowledging or the service stops recording
+			void Stream(WebSocket& socket, int rendition, size_t window, Stats& stats);
+
+			SharedPtr<WebcamService> webcamService;
+			const WebSocketStreamRequestHandlerFactory::Config config;
+			std::atomic<int>& clients;
+		};
+	}
+}
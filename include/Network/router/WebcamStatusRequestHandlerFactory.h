@@ -0,0 +1,49 @@
+//============================================================================
+// Name        : WebcamStatusRequestHandlerFactory.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : JSON report of the pipeline state under /api/webcam/status
+//============================================================================
+#pragma once
+#include "../../services/webcam/WebcamService.h"
+#include "MjpegBroadcaster.h"
+#include "Poco\Net\HTTPRequestHandlerFactory.h"
+#include "Poco\Net\HTTPRequestHandler.h"
+#include "Poco\Net\HTTPServerRequest.h"
+#include "Poco\Net\HTTPServerResponse.h"
+#include "Poco\SharedPtr.h"
+
+using Poco::Net::HTTPRequestHandlerFactory;
+using Poco::Net::HTTPRequestHandler;
+using Poco::Net::HTTPServerRequest;
+using Poco::Net::HTTPServerResponse;
+using Poco::SharedPtr;
+using services::webcam::WebcamService;
+
+namespace infrastructure {
+	namespace video_streaming {
+		class WebcamStatusRequestHandlerFactory : public HTTPRequestHandlerFactory
+		{
+		public:
+			WebcamStatusRequestHandlerFactory(SharedPtr<WebcamService> webcamService, SharedPtr<MjpegBroadcaster> broadcaster);
+			~WebcamStatusRequestHandlerFactory();
+			HTTPRequestHandler* createRequestHandler(const HTTPServerRequest& request);
+		private:
+			SharedPtr<WebcamService> webcamService;
+			SharedPtr<MjpegBroadcaster> broadcaster;
+		};
+
+		// reports what the governor chose, the effective quality of every rendition,
+		// viewer counts and stage timings
+		class WebcamStatusRequestHandler : public HTTPRequestHandler
+		{
+		public:
+			WebcamStatusRequestHandler(SharedPtr<WebcamService> webcamService, SharedPtr<MjpegBroadcaster> broadcaster);
+			~WebcamStatusRequestHandler();
+			void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response);
+		private:
+			SharedPtr<WebcamService> webcamService;
+			SharedPtr<MjpegBroadcaster> broadcaster;
+		};
+	}
+}
@@ -0,0 +1,109 @@
+//============================================================================
+// Name        : BufferPool.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Size classed pool recycling frame memory and JPEG buffers
+//============================================================================
+#pragma once
+
+#include "opencv2\core\core.hpp"
+#include "Poco\RefCountedObject.h"
+#include "Poco\AutoPtr.h"
+#include "Poco\Mutex.h"
+#include "Poco\Types.h"
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace services {
+	namespace webcam {
+		// Frames of a stream come in a handful of sizes, so memory returned by one frame
+		// fits the next one of the same kind. Requests are rounded up to size classes a
+		// quarter power of two apart and served from idle buffers of that class.
+		//  - Pixel memory is handed out through a cv::MatAllocator: blocks are aligned to a
+		//    cache line and, with hugePages, large blocks are backed by transparent huge pages.
+		//  - JPEG buffers are vectors whose storage is taken back when the last reference to
+		//    an EncodedFrame goes away.
+		// Every outstanding block holds a reference to the pool, so Mats may outlive its owner.
+		class BufferPool : public Poco::RefCountedObject {
+		public:
+			typedef Poco::AutoPtr<BufferPool> Ptr;
+
+			struct Config {
+				Config() : maxIdle(64), hugePages(false) { }
+
+				int maxIdle;         // MB kept in idle buffers over all classes, more is freed
+				bool hugePages;      // back blocks of 2 MB and more with transparent huge pages, Linux only
+			};
+
+			struct Stats {
+				Poco::UInt64 hits;       // requests served from idle buffers
+				Poco::UInt64 misses;     // requests that had to allocate, constant in the steady state
+				Poco::UInt64 freed;      // buffers freed because the idle limit was reached
+				Poco::UInt64 idleBytes;
+				Poco::UInt64 usedBytes;  // pixel blocks handed out and not returned yet
+			};
+
+			explicit BufferPool(const Config& config = Config());
+
+			// allocator to assign to Mat::allocator before create(), the Mat then takes its pixels from the pool
+			cv::MatAllocator* GetMatAllocator();
+			// aligned block of at least size bytes
+			void* Allocate(size_t size);
+			void Release(void* block);
+
+			// swaps an idle vector with a capacity of at least size into buffer, the previous
+			// content of buffer is recycled. buffer is empty afterwards.
+			void Acquire(size_t size, vector<uchar>& buffer);
+			// takes over the storage of buffer
+			void Recycle(vector<uchar>& buffer);
+
+			Stats GetStats();
+			string ToString();
+		protected:
+			~BufferPool();
+		private:
+			BufferPool(const BufferPool&);
+			BufferPool& operator=(const BufferPool&);
+
+			class MatAllocator : public cv::MatAllocator {
+			public:
+				explicit MatAllocator(BufferPool& pool);
+				cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+					cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const;
+				bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const;
+				void deallocate(cv::UMatData* data) const;
+			private:
+				BufferPool& pool;
+			};
+
+			// precedes every block, keeps the block aligned
+			struct BlockHeader {
+				size_t size;       // usable bytes behind the header
+				int sizeClass;
+				bool mapped;       // allocated with mmap for huge pages
+			};
+
+			static size_t GetClassSize(int sizeClass);
+			// smallest class that holds size bytes
+			static int GetClass(size_t size);
+			// largest class a buffer of capacity bytes can serve
+			static int GetFloorClass(size_t capacity);
+
+			void* AllocateBlock(size_t size, bool& mapped);
+			void FreeBlock(BlockHeader* header);
+			// true if another buffer of size bytes may stay idle
+			bool KeepIdle(size_t size);
+
+			const Config config;
+			Poco::FastMutex mutex;
+			MatAllocator matAllocator;
+			vector<vector<BlockHeader*>> idleBlocks;    // per class
+			vector<vector<vector<uchar>>> idleBuffers;  // per class
+			Stats stats;
+		};
+	}
+}
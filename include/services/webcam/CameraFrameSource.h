@@ -0,0 +1,62 @@
+//============================================================================
+// Name        : CameraFrameSource.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Frame source reading from a local camera device
+//============================================================================
+#pragma once
+#include "FrameSource.h"
+
+#include "opencv2\opencv.hpp"
+#include "Poco\Types.h"
+
+using cv::VideoCapture;
+
+namespace services {
+	namespace webcam {
+		class CameraFrameSource : public FrameSource {
+		public:
+			// width or height of 0 keeps the driver default resolution. lowLatency asks the driver
+			// for a single buffer and drains stale frames before retrieving the newest one
+			CameraFrameSource(int deviceIndex = 0, double fps = 15, int width = 0, int height = 0, bool lowLatency = false);
+			~CameraFrameSource();
+
+			bool Open();
+			void Close();
+			bool IsOpened();
+			bool Read(Mat& frame);
+			bool Read(Mat& frame, Poco::Timestamp& captured);
+			bool IsSelfPaced();
+			bool SetPassthrough(bool enable);
+			bool IsPassthrough();
+			bool ReadCompressed(vector<uchar>& jpeg, Poco::Timestamp& captured);
+			bool SetNativeYUV(bool enable);
+			bool IsNativeYUV();
+			bool ReadYUV(Mat& yuv, Poco::Timestamp& captured);
+			double GetFPS();
+			int GetWidth();
+			int GetHeight();
+			string GetName();
+		private:
+			int deviceIndex;
+			double fps;
+			int width;
+			int height;
+			bool lowLatency;
+			bool passthrough;       // requested, the device is asked for MJPEG on Open()
+			bool compressed;        // the device delivers JPEG and frames are read undecoded
+			bool nativeYuv;         // requested, conversion to BGR is turned off on Open()
+			int yuvFormat;          // FOURCC of the unconverted frames, 0 while frames are converted to BGR
+			int yuvWidth;
+			int yuvHeight;
+			Mat raw;                // unconverted driver buffer, reused between reads
+			Poco::UInt64 drained;   // stale frames grabbed and thrown away since Open()
+			VideoCapture capture;
+
+			// grabs the next frame without decoding it, draining stale ones in low latency mode
+			bool Grab(Poco::Timestamp& captured);
+			// switches back to BGR frames when the device does not deliver what was asked for
+			void StopRawFrames(const string& reason);
+		};
+	}
+}
@@ -0,0 +1,75 @@
+//============================================================================
+// Name        : CapturedFrame.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Read-only, reference counted handle of a captured frame
+//============================================================================
+#pragma once
+
+#include "RawFrame.h"
+
+#include "opencv2\core\core.hpp"
+#include "Poco\RefCountedObject.h"
+#include "Poco\AutoPtr.h"
+#include "Poco\Mutex.h"
+#include "Poco\Timestamp.h"
+#include "Poco\Types.h"
+
+#include <atomic>
+
+using cv::Mat;
+
+namespace services {
+	namespace webcam {
+		// Handed out to consumers of the raw frames, e.g. analytics. The frame is never
+		// written after capture, so a handle stays valid and unchanged for as long as it is
+		// held, no matter how many frames the camera delivers meanwhile.
+		class CapturedFrame : public Poco::RefCountedObject {
+		public:
+			typedef Poco::AutoPtr<CapturedFrame> Ptr;
+
+			// shares the pixels of frame, which must not be written afterwards
+			explicit CapturedFrame(const RawFrame& frame);
+
+			// capture counter, increases by one per frame taken from the source
+			Poco::UInt64 GetSequence() const;
+			const Poco::Timestamp& GetCaptured() const;
+			cv::Size GetSize() const;
+			// BGR pixels, decoded or converted on first use if the frame was captured as JPEG
+			// or YUV. Empty if that failed. Read only, other holders share the pixels.
+			const Mat& GetImage() const;
+			// JPEG as delivered by the source in passthrough mode, null otherwise
+			EncodedFrame::Ptr GetCompressed() const;
+			// I420 as delivered by the source in native YUV mode, empty otherwise
+			const Mat& GetYUV() const;
+		protected:
+			~CapturedFrame();
+		private:
+			CapturedFrame(const CapturedFrame&);
+			CapturedFrame& operator=(const CapturedFrame&);
+
+			mutable RawFrame frame;
+			mutable Poco::FastMutex decodeMutex; //only taken until the first decode finished
+			mutable std::atomic<bool> decoded;
+		};
+
+		//
+		// inlines
+		//
+		inline Poco::UInt64 CapturedFrame::GetSequence() const {
+			return frame.sequence;
+		}
+
+		inline const Poco::Timestamp& CapturedFrame::GetCaptured() const {
+			return frame.captured;
+		}
+
+		inline EncodedFrame::Ptr CapturedFrame::GetCompressed() const {
+			return frame.compressed;
+		}
+
+		inline const Mat& CapturedFrame::GetYUV() const {
+			return frame.yuv;
+		}
+	}
+}
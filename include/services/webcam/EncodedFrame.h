@@ -0,0 +1,74 @@
+//============================================================================
+// Name        : EncodedFrame.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Immutable, reference counted JPEG frame shared by all viewers
+//============================================================================
+#pragma once
+
+#include "Poco\RefCountedObject.h"
+#include "Poco\AutoPtr.h"
+#include "Poco\Timestamp.h"
+#include "Poco\Types.h"
+#include "BufferPool.h"
+
+#include <vector>
+
+using std::vector;
+
+namespace services {
+	namespace webcam {
+		// Published once per encoded frame. Viewers only hold references, the
+		// payload is never copied or modified after construction.
+		class EncodedFrame : public Poco::RefCountedObject {
+		public:
+			typedef Poco::AutoPtr<EncodedFrame> Ptr; //only const accessors, so sharing is safe
+
+			// takes over the content of data, leaving it empty. With a pool the storage of data
+			// is recycled once the last reference is gone.
+			EncodedFrame(Poco::UInt64 sequence, const Poco::Timestamp& timestamp, vector<unsigned char>& data,
+				BufferPool::Ptr pool = nullptr);
+			// republishes the payload of source under another sequence without copying it,
+			// source is kept alive as long as this frame
+			EncodedFrame(Poco::UInt64 sequence, EncodedFrame::Ptr source);
+
+			Poco::UInt64 GetSequence() const;
+			// capture time of the source frame
+			const Poco::Timestamp& GetTimestamp() const;
+			const unsigned char* GetData() const;
+			size_t GetSize() const;
+		protected:
+			~EncodedFrame();
+		private:
+			EncodedFrame(const EncodedFrame&);
+			EncodedFrame& operator=(const EncodedFrame&);
+
+			const Poco::UInt64 sequence;
+			const Poco::Timestamp timestamp;
+			vector<unsigned char> data;
+			BufferPool::Ptr pool;
+			const EncodedFrame::Ptr source;
+			const unsigned char* bytes;    // data, or the payload of source
+			const size_t size;
+		};
+
+		//
+		// inlines
+		//
+		inline Poco::UInt64 EncodedFrame::GetSequence() const {
+			return sequence;
+		}
+
+		inline const Poco::Timestamp& EncodedFrame::GetTimestamp() const {
+			return timestamp;
+		}
+
+		inline const unsigned char* EncodedFrame::GetData() const {
+			return bytes;
+		}
+
+		inline size_t EncodedFrame::GetSize() const {
+			return size;
+		}
+	}
+}
@@ -0,0 +1,93 @@
+//============================================================================
+// Name        : EncodingGovernor.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Keeps the pipeline within a CPU budget by lowering JPEG quality
+//               and then frame rate under load and raising them again later
+//============================================================================
+#pragma once
+
+#include "Poco\Clock.h"
+#include "Poco\Mutex.h"
+#include "Poco\Types.h"
+
+#include <string>
+
+using std::string;
+
+namespace services {
+	namespace webcam {
+		// The load of a period is the highest of
+		//  - encode time per frame relative to the frame interval,
+		//  - busy part of the capture loop, 1 - slack / frame interval,
+		//  - process CPU relative to cpuBudget, if a budget is set.
+		// Above highLoad quality is lowered first and the frame rate once quality is at its
+		// minimum. Only after holdPeriods periods below lowLoad is the frame rate raised
+		// again, then quality, so the governor does not oscillate around one threshold.
+		class EncodingGovernor {
+		public:
+			struct Config {
+				Config() : enabled(true), cpuBudget(0), minQuality(40), qualityStep(10), minFps(2), period(2000),
+					highLoad(0.9), lowLoad(0.6), holdPeriods(3) { }
+
+				bool enabled;
+				double cpuBudget;    // percent of one core the process may use, 0 does not watch CPU
+				int minQuality;      // quality is never lowered below this
+				int qualityStep;     // quality change per step
+				double minFps;       // frame rate is never lowered below this
+				int period;          // ms between evaluations
+				double highLoad;     // load above which the governor steps down
+				double lowLoad;      // load below which the governor may step up
+				int holdPeriods;     // consecutive periods below lowLoad before stepping up
+			};
+
+			struct State {
+				bool enabled;
+				int qualityDrop;     // subtracted from the quality of every rendition
+				double fps;          // capture rate chosen by the governor
+				double sourceFps;    // rate the source was opened with, the upper bound
+				double load;         // highest of the loads below in the last period
+				double encodeLoad;
+				double captureLoad;
+				double cpuPercent;   // process CPU in the last period, percent of one core
+				Poco::UInt64 adjustments;
+			};
+
+			explicit EncodingGovernor(const Config& config);
+
+			// starts over at full quality and the source frame rate
+			void Reset(double sourceFps);
+			// time left in the frame interval after a capture, negative when behind. Capture thread only
+			void RecordSlack(Poco::Clock::ClockDiff slackUs);
+			// evaluates the last period once it is over, called regularly by the encoding thread
+			// with the average encode time and the number of frames encoded so far.
+			// Returns true if quality or frame rate changed.
+			bool Update(double encodeAverageMs, Poco::UInt64 encodedFrames);
+
+			// quality to use for a rendition configured with requested
+			int GetQuality(int requested);
+			double GetFPS();
+			State GetState();
+			string ToString();
+		private:
+			EncodingGovernor(const EncodingGovernor&);
+			EncodingGovernor& operator=(const EncodingGovernor&);
+
+			// process CPU time in us, user and system
+			static Poco::Int64 GetProcessTime();
+
+			void StepDown();
+			void StepUp();
+
+			const Config config;
+			Poco::FastMutex mutex;
+			State state;
+			Poco::Clock periodStart;
+			Poco::Int64 periodCpu;
+			Poco::UInt64 periodFrames;
+			Poco::Int64 slackSum;   // us
+			int slackCount;
+			int quietPeriods;       // consecutive periods below lowLoad
+		};
+	}
+}
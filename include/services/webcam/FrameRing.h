@@ -0,0 +1,46 @@
+//============================================================================
+// Name        : FrameRing.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Fixed capacity history of the last encoded frames of a rendition
+//============================================================================
+#pragma once
+
+#include "EncodedFrame.h"
+
+#include "Poco\Timestamp.h"
+#include "Poco\Types.h"
+
+#include <vector>
+
+using std::vector;
+
+namespace services {
+	namespace webcam {
+		// Frames are added with consecutive sequence numbers, each one overwrites the frame
+		// capacity sequences older. Not synchronized, the owner guards it.
+		class FrameRing {
+		public:
+			explicit FrameRing(size_t capacity);
+
+			void Add(EncodedFrame::Ptr frame);
+			// null before the first frame
+			EncodedFrame::Ptr GetLatest() const;
+			// the frame following sequence, or the oldest one still kept if that was already
+			// overwritten. Null if there is no newer frame yet.
+			EncodedFrame::Ptr GetAfter(Poco::UInt64 sequence) const;
+			// the oldest kept frame captured after captured, null if there is none yet
+			EncodedFrame::Ptr GetAfter(const Poco::Timestamp& captured) const;
+			// sequence of the latest frame, 0 before the first one
+			Poco::UInt64 GetSequence() const;
+			size_t GetCapacity() const;
+		private:
+			// frame with the given sequence, which must be kept
+			const EncodedFrame::Ptr& At(Poco::UInt64 sequence) const;
+			Poco::UInt64 GetOldestSequence() const;
+
+			vector<EncodedFrame::Ptr> frames;
+			Poco::UInt64 sequence;
+		};
+	}
+}
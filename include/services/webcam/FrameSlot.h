@@ -0,0 +1,45 @@
+//============================================================================
+// Name        : FrameSlot.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Lock-free slot holding the latest captured frame
+//============================================================================
+#pragma once
+
+#include "CapturedFrame.h"
+
+#include "Poco\Types.h"
+
+#include <atomic>
+
+namespace services {
+	namespace webcam {
+		// Triple buffer between the capture thread and any number of readers. The writer
+		// fills a slot that is neither current nor being read and then makes it current,
+		// readers pin the current slot just long enough to take a reference to its frame.
+		// Neither side takes a lock, the writer never waits for a reader to finish with a
+		// frame and readers only retry if a new frame was published while they pinned.
+		class FrameSlot {
+		public:
+			FrameSlot();
+
+			// only called by one thread at a time
+			void Publish(CapturedFrame::Ptr frame);
+			// latest published frame, null before the first one
+			CapturedFrame::Ptr Get() const;
+			// sequence of the latest published frame, 0 before the first one
+			Poco::UInt64 GetSequence() const;
+			void Clear();
+		private:
+			FrameSlot(const FrameSlot&);
+			FrameSlot& operator=(const FrameSlot&);
+
+			static const int SLOTS = 3;
+
+			CapturedFrame::Ptr frames[SLOTS];
+			mutable std::atomic<int> pins[SLOTS];  // readers copying the reference out of a slot
+			std::atomic<int> current;
+			std::atomic<Poco::UInt64> sequence;
+		};
+	}
+}
@@ -0,0 +1,72 @@
+//============================================================================
+// Name        : FrameSource.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Abstract producer of raw frames consumed by WebcamService
+//============================================================================
+#pragma once
+
+#include "opencv2\core\core.hpp"
+#include "Poco\SharedPtr.h"
+#include "Poco\Timestamp.h"
+
+#include <string>
+#include <vector>
+
+using cv::Mat;
+using std::string;
+using std::vector;
+
+namespace services {
+	namespace webcam {
+		class FrameSource {
+		public:
+			typedef Poco::SharedPtr<FrameSource> Ptr;
+
+			virtual ~FrameSource() { }
+
+			// acquires the underlying device or file, returns false if it is not available
+			virtual bool Open() = 0;
+			virtual void Close() = 0;
+			virtual bool IsOpened() = 0;
+
+			// reads the next frame into frame, returns false if no frame could be produced.
+			// Sources do not pace themselves, the recording thread schedules the reads.
+			virtual bool Read(Mat& frame) = 0;
+			// like Read(frame), captured is set to the moment the frame was taken from the device
+			virtual bool Read(Mat& frame, Poco::Timestamp& captured) {
+				bool read = Read(frame);
+				captured.update();
+				return read;
+			}
+			// true for sources whose Read() blocks until the device delivers the next frame.
+			// The recording thread then paces from capture timestamps instead of sleeping.
+			virtual bool IsSelfPaced() { return false; }
+
+			// asks the source to hand out frames as the JPEG it receives instead of decoding them,
+			// takes effect with the next Open(). Returns false if the source cannot do that.
+			virtual bool SetPassthrough(bool enable) { return !enable; }
+			// true while frames are read with ReadCompressed(). A source may fall back to Read()
+			// on its own, e.g. when the device turns out not to deliver JPEG.
+			virtual bool IsPassthrough() { return false; }
+			// reads the next frame as a complete JPEG including Huffman tables, returns false if no
+			// frame could be produced
+			virtual bool ReadCompressed(vector<uchar>& jpeg, Poco::Timestamp& captured) { return false; }
+
+			// asks the source for planar YCbCr 4:2:0 (I420, see YuvImage) as the device delivers it
+			// instead of BGR, takes effect with the next Open(). Returns false if the source cannot do that.
+			virtual bool SetNativeYUV(bool enable) { return !enable; }
+			// true while frames are read with ReadYUV(), the source may fall back to Read() on its own
+			virtual bool IsNativeYUV() { return false; }
+			virtual bool ReadYUV(Mat& yuv, Poco::Timestamp& captured) { return false; }
+
+			// nominal frame rate of the source, used by the recording thread for pacing
+			virtual double GetFPS() = 0;
+			virtual int GetWidth() = 0;
+			virtual int GetHeight() = 0;
+
+			// human readable description for logging
+			virtual string GetName() = 0;
+		};
+	}
+}
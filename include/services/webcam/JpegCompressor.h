@@ -0,0 +1,76 @@
+//============================================================================
+// Name        : JpegCompressor.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : libjpeg compressor kept alive across frames, encodes BGR and
+//               planar YCbCr 4:2:0 frames
+//============================================================================
+#pragma once
+
+#include "opencv2\core\core.hpp"
+
+#include <string>
+#include <vector>
+
+using cv::Mat;
+using std::string;
+using std::vector;
+
+namespace services {
+	namespace webcam {
+		// cv::imencode sets up a new libjpeg compressor with default tables for every call and
+		// only exposes the quality. This one is created once per stream: Huffman tables stay
+		// allocated, quantization tables are only rebuilt when the quality changes and the
+		// output buffer is sized from the previous frame.
+		// An I420 frame (see YuvImage) is handed to libjpeg's raw data interface as it is,
+		// so YUV from the camera is not converted on the way.
+		// Not thread safe, one instance per encoding thread or stripe.
+		class JpegCompressor {
+		public:
+			enum Subsampling {
+				SUBSAMPLING_444,
+				SUBSAMPLING_422,
+				SUBSAMPLING_420
+			};
+
+			struct Settings {
+				Settings() : subsampling(SUBSAMPLING_420), optimizeHuffman(false), restartRows(0) { }
+
+				// whether parts encoded with these settings can be joined by StripedJpegEncoder::Stitch,
+				// which needs equal Huffman tables and sets the restart interval itself
+				bool IsStitchable() const { return !optimizeHuffman && restartRows == 0; }
+
+				Subsampling subsampling; // chroma resolution for BGR input, YUV input stays 4:2:0
+				bool optimizeHuffman;    // a second pass builds tables for each frame, a few percent smaller
+				int restartRows;         // MCU rows between restart markers, 0 = none
+			};
+
+			// "444" or "422", anything else is 4:2:0
+			static Subsampling ParseSubsampling(const string& name);
+
+			explicit JpegCompressor(const Settings& settings = Settings());
+			~JpegCompressor();
+
+			// encodes a CV_8UC3 BGR image, returns false for other types or if libjpeg fails
+			bool Encode(const Mat& image, int quality, vector<uchar>& output);
+			// encodes the picture rows [rows.start, rows.end) of an I420 frame, rows.start has to be even
+			bool EncodeYUV(const Mat& yuv, const cv::Range& rows, int quality, vector<uchar>& output);
+
+			const Settings& GetSettings() const;
+		private:
+			JpegCompressor(const JpegCompressor&);
+			JpegCompressor& operator=(const JpegCompressor&);
+
+			struct Context; // libjpeg state, keeps jpeglib.h out of this header
+
+			// sets up the next frame, input is JCS_YCbCr for raw data or the BGR colour space
+			void Prepare(int width, int height, int quality, bool rawData, vector<uchar>& output);
+
+			const Settings settings;
+			Context* context;
+			int quality;          // quality the quantization tables were built for, 0 before the first frame
+			size_t lastSize;      // size of the previous output, the next buffer starts a bit larger
+			vector<uchar> scratch;
+		};
+	}
+}
@@ -0,0 +1,33 @@
+//============================================================================
+// Name        : JpegStream.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Inspects and patches JPEG bitstreams without decoding them
+//============================================================================
+#pragma once
+
+#include "opencv2\core\core.hpp"
+
+#include <vector>
+
+using std::vector;
+
+namespace services {
+	namespace webcam {
+		class JpegStream {
+		public:
+			// true if data starts with SOI
+			static bool IsJpeg(const uchar* data, size_t size);
+			// reads the image size from the frame header
+			static bool GetSize(const uchar* jpeg, size_t length, cv::Size& size);
+			// Motion JPEG from cameras usually leaves out the Huffman tables and relies on the
+			// standard ones (ITU T.81 Annex K.3). Inserts them in front of the scan if no DHT
+			// segment is present, so any decoder accepts the frame. Returns false if jpeg cannot be parsed.
+			static bool AddDefaultHuffmanTables(vector<uchar>& jpeg);
+		private:
+			// offset of the first marker among markers before the scan, the SOS offset if none
+			// of them occurs. Returns false if the segments cannot be walked up to SOS.
+			static bool FindMarker(const uchar* jpeg, size_t size, const uchar* markers, size_t count, size_t& offset, size_t& sos);
+		};
+	}
+}
@@ -0,0 +1,110 @@
+//============================================================================
+// Name        : ProcessingGraph.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Processing stages fed from the capture thread, each on its own worker
+//============================================================================
+#pragma once
+#include "..\..\shared\observer\IObserver.h"
+#include "..\..\shared\queue\BoundedQueue.h"
+#include "ProcessingStage.h"
+#include "StageStats.h"
+
+#include "Poco\Thread.h"
+#include "Poco\RunnableAdapter.h"
+#include "Poco\Mutex.h"
+#include "Poco\SharedPtr.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace services {
+	namespace webcam {
+		class WebcamService;
+
+		// Observes the WebcamService. On every captured frame Update() only queues the frame
+		// for the stages without upstream stage, so the capture thread never waits for one.
+		// Each stage hands its result to the stages added after it. The stage list is copied
+		// on every change, stages can be added and removed while frames flow.
+		class ProcessingGraph : public IObserver<WebcamService> {
+		public:
+			struct Config {
+				Config() : queueSize(2) { }
+
+				int queueSize;       // frames queued per stage, the oldest is dropped when full
+			};
+
+			struct StageStatus {
+				string name;
+				string upstream;     // empty for stages fed by the camera
+				size_t queued;
+				StageStats::Snapshot process; // time spent in Process()
+				StageStats::Snapshot latency; // from capture until the stage finished the frame
+			};
+
+			explicit ProcessingGraph(const Config& config = Config());
+			~ProcessingGraph();
+
+			// starts stage on its own thread. It gets the frames upstream returns, or the captured
+			// frames if upstream is empty. Returns false if the name is taken or upstream unknown.
+			bool AddStage(ProcessingStage::Ptr stage, const string& upstream = "");
+			// stops the stage and all stages downstream of it after their current frame,
+			// returns false if there is no such stage. Must not be called from a stage.
+			bool RemoveStage(const string& name);
+			void RemoveAll();
+
+			void Update(WebcamService* service);
+
+			vector<StageStatus> GetStatus();
+			// clears the maxima so periodic reports show the worst case per period
+			void ResetMax();
+			// one line per stage for the log, empty without stages
+			string ToString();
+		private:
+			ProcessingGraph(const ProcessingGraph&);
+			ProcessingGraph& operator=(const ProcessingGraph&);
+
+			class Worker {
+			public:
+				Worker(ProcessingGraph& graph, ProcessingStage::Ptr stage, const string& name, const string& upstream, size_t queueSize);
+				~Worker();
+
+				void Start();
+				void Stop();
+				// never blocks, counts a drop if the queue was full
+				void Push(CapturedFrame::Ptr frame);
+				StageStatus GetStatus();
+				void ResetMax();
+
+				const string name;
+				const string upstream;
+			private:
+				void Run();
+
+				ProcessingGraph& graph;
+				ProcessingStage::Ptr stage;
+				std::atomic<bool> running;
+				BoundedQueue<CapturedFrame::Ptr> queue;
+				StageStats processStats;
+				StageStats latencyStats;
+				Poco::Thread thread;
+				Poco::RunnableAdapter<Worker> adapter;
+			};
+
+			typedef vector<Poco::SharedPtr<Worker>> Workers;
+
+			// queues frame for all stages fed by upstream
+			void Dispatch(const string& upstream, CapturedFrame::Ptr frame);
+			Poco::SharedPtr<Workers> GetWorkers();
+
+			const Config config;
+			Poco::FastMutex workersMutex;       // only guards the pointer, a list never changes once published
+			Poco::FastMutex changeMutex;        // serializes AddStage() and RemoveStage()
+			Poco::SharedPtr<Workers> workers;
+		};
+	}
+}
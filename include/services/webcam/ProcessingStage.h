@@ -0,0 +1,36 @@
+//============================================================================
+// Name        : ProcessingStage.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : One step of the processing graph fed with captured frames
+//============================================================================
+#pragma once
+
+#include "CapturedFrame.h"
+
+#include "Poco\SharedPtr.h"
+
+#include <string>
+
+using std::string;
+
+namespace services {
+	namespace webcam {
+		// Overlays, analytics and the like. Every stage of a ProcessingGraph runs on its own
+		// thread, so Process() may take as long as it needs without holding up capture or
+		// other stages. Frames that arrive while it is busy are queued and the oldest dropped.
+		class ProcessingStage {
+		public:
+			typedef Poco::SharedPtr<ProcessingStage> Ptr;
+
+			virtual ~ProcessingStage() { }
+
+			// unique within the graph, downstream stages refer to it
+			virtual string GetName() = 0;
+			// called on the stage's thread, one frame at a time. Returns the frame handed to
+			// downstream stages: frame itself, a new one (e.g. with an overlay drawn into a copy
+			// of its pixels) or null to stop it here. frame is shared and must not be written.
+			virtual CapturedFrame::Ptr Process(CapturedFrame::Ptr frame) = 0;
+		};
+	}
+}
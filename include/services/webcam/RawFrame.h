@@ -0,0 +1,36 @@
+//============================================================================
+// Name        : RawFrame.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Captured, not yet encoded frame passed between pipeline stages
+//============================================================================
+#pragma once
+
+#include "EncodedFrame.h"
+
+#include "opencv2\core\core.hpp"
+#include "Poco\Timestamp.h"
+#include "Poco\Types.h"
+
+using cv::Mat;
+
+namespace services {
+	namespace webcam {
+		struct RawFrame {
+			RawFrame() : sequence(0) { }
+
+			// decodes compressed or converts yuv into image unless that already happened, returns
+			// false if there are no pixels. Only the stage owning the frame may call it.
+			bool Decode();
+			// size of the frame, read from the JPEG header in passthrough mode
+			cv::Size GetSize() const;
+
+			Mat image;                  // owned by this frame, never written after capture. Empty until
+			                            // Decode() if the frame was captured compressed or in YUV
+			EncodedFrame::Ptr compressed; // JPEG as delivered by the source in passthrough mode
+			Mat yuv;                    // I420 as delivered by the source in native YUV mode
+			Poco::UInt64 sequence;      // capture counter, starts at 1
+			Poco::Timestamp captured;   // taken right after the source returned the frame
+		};
+	}
+}
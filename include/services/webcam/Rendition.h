@@ -0,0 +1,49 @@
+//============================================================================
+// Name        : Rendition.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : One output of the encoding ladder, e.g. full, 720p or thumbnail
+//============================================================================
+#pragma once
+
+#include "opencv2\core\core.hpp"
+
+#include <algorithm>
+#include <string>
+
+using std::string;
+
+namespace services {
+	namespace webcam {
+		struct Rendition {
+			Rendition() : name("full"), width(0), height(0), quality(100), fps(0) { }
+			Rendition(const string& name, int width, int height, int quality, double fps)
+				: name(name), width(width), height(height), quality(quality), fps(fps) { }
+
+			string name;    // selected by viewers with ?rendition=<name>
+			int width;      // maximum width, 0 does not limit the width
+			int height;     // maximum height, 0 does not limit the height
+			int quality;    // JPEG quality 1..100
+			double fps;     // upper bound for the frame rate, 0 follows the source
+
+			// size of a frame of the given source size in this rendition.
+			// Keeps the aspect ratio and never scales up.
+			cv::Size GetSize(const cv::Size& source) const {
+				double scale = 1.0;
+				if (width > 0 && width < source.width) {
+					scale = static_cast<double>(width) / source.width;
+				}
+				if (height > 0 && height < source.height * scale) {
+					scale = static_cast<double>(height) / source.height;
+				}
+				if (scale >= 1.0) {
+					return source;
+				}
+				// even dimensions keep chroma subsampling aligned
+				int scaledWidth = std::max(2, static_cast<int>(source.width * scale + 0.5) & ~1);
+				int scaledHeight = std::max(2, static_cast<int>(source.height * scale + 0.5) & ~1);
+				return cv::Size(scaledWidth, scaledHeight);
+			}
+		};
+	}
+}
@@ -0,0 +1,59 @@
+//============================================================================
+// Name        : ReplayFrameSource.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Replays a video file or a directory of JPEG images
+//============================================================================
+#pragma once
+#include "FrameSource.h"
+
+#include "opencv2\opencv.hpp"
+
+#include <vector>
+
+using cv::VideoCapture;
+using std::vector;
+
+namespace services {
+	namespace webcam {
+		class ReplayFrameSource : public FrameSource {
+		public:
+			// path is either a video file or a directory of *.jpg/*.jpeg files replayed in name order.
+			// fps is used for directories and for files that do not report a frame rate.
+			ReplayFrameSource(const string& path, double fps = 15, bool loop = true);
+			~ReplayFrameSource();
+
+			bool Open();
+			void Close();
+			bool IsOpened();
+			bool Read(Mat& frame);
+			bool SetPassthrough(bool enable);
+			bool IsPassthrough();
+			bool ReadCompressed(vector<uchar>& jpeg, Poco::Timestamp& captured);
+			double GetFPS();
+			int GetWidth();
+			int GetHeight();
+			string GetName();
+		private:
+			string path;
+			double fps;
+			bool loop;
+			bool isDirectory;
+			bool isOpened;
+			bool passthrough;       // requested, takes effect on Open()
+			bool compressed;        // frames are read undecoded
+			int width;
+			int height;
+			VideoCapture capture;
+			vector<string> files;
+			size_t nextFile;
+
+			// asks the video backend for undecoded packets, FFmpeg only
+			bool OpenFile();
+			bool ReadFile(Mat& frame);
+			bool ReadDirectory(Mat& frame);
+			// path of the next image in the directory, false at the end when not looping
+			bool NextFile(string& file);
+		};
+	}
+}
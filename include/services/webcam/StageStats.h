@@ -0,0 +1,43 @@
+//============================================================================
+// Name        : StageStats.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Timing and drop counters of one pipeline stage
+//============================================================================
+#pragma once
+
+#include "Poco\Mutex.h"
+#include "Poco\Types.h"
+
+#include <string>
+
+using std::string;
+
+namespace services {
+	namespace webcam {
+		class StageStats {
+		public:
+			struct Snapshot {
+				Poco::UInt64 frames;
+				Poco::UInt64 dropped;
+				double lastMs;
+				double averageMs;   // exponentially weighted, roughly the last 30 frames
+				double maxMs;       // since the last Reset()
+			};
+
+			explicit StageStats(const string& name);
+
+			void Record(Poco::Int64 elapsedUs);
+			void RecordDrop();
+			Snapshot GetSnapshot();
+			// clears the maximum so periodic reports show the worst case per period
+			void ResetMax();
+			const string& GetName() const;
+			string ToString();
+		private:
+			const string name;
+			Poco::FastMutex mutex;
+			Snapshot stats;
+		};
+	}
+}
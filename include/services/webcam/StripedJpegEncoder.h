@@ -0,0 +1,65 @@
+//============================================================================
+// Name        : StripedJpegEncoder.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Encodes horizontal stripes of a frame in parallel and joins
+//               them into one baseline JPEG using restart markers
+//============================================================================
+#pragma once
+
+#include "JpegCompressor.h"
+
+#include "opencv2\core\core.hpp"
+#include "opencv2\imgcodecs.hpp"
+#include "Poco\SharedPtr.h"
+
+#include <functional>
+#include <vector>
+
+using cv::Mat;
+using std::vector;
+
+namespace services {
+	namespace webcam {
+		// Every stripe is a complete JPEG of its own. Since a restart marker resets the
+		// DC predictors just like the start of a scan, the entropy coded data of the
+		// stripes can be concatenated with RSTn markers in between once the restart
+		// interval is set to the number of MCUs per stripe.
+		// One instance per encoding thread, the compressors and stripe buffers are reused between frames.
+		class StripedJpegEncoder {
+		public:
+			// stripes: upper bound of stripes per frame, 0 uses the OpenCV thread count, 1 disables striping.
+			// Settings that rule out joining stripes (see Settings::IsStitchable()) disable striping as well.
+			explicit StripedJpegEncoder(int stripes = 0, const JpegCompressor::Settings& settings = JpegCompressor::Settings());
+
+			// encodes a BGR image, on one thread for small images or if the stripes cannot be joined.
+			// Other image types go through cv::imencode.
+			bool Encode(const Mat& image, int quality, vector<uchar>& output);
+			// encodes an I420 frame (see YuvImage), in stripes like Encode()
+			bool EncodeYUV(const Mat& yuv, int quality, vector<uchar>& output);
+			int GetStripes() const;
+
+			// joins stripe JPEGs of equal stripeHeight (the last one may be shorter) into
+			// one image of the given height. Returns false if the stripes are not compatible.
+			static bool Stitch(const vector<vector<uchar>>& parts, int height, int stripeHeight, vector<uchar>& output);
+		private:
+			StripedJpegEncoder(const StripedJpegEncoder&);
+			StripedJpegEncoder& operator=(const StripedJpegEncoder&);
+
+			typedef std::function<bool(JpegCompressor&, const cv::Range&, vector<uchar>&)> StripeEncoder;
+
+			// encodes the rows in stripes with encode and joins them into output. Returns false if the
+			// frame is too small for stripes or they failed, output is left for a single-threaded encode then.
+			bool EncodeStripes(int rows, const StripeEncoder& encode, vector<uchar>& output);
+
+			// compressor for stripe i, created on first use
+			JpegCompressor& GetCompressor(size_t i);
+
+			int stripes;
+			bool incompatible;             // stripes could not be joined with the parameters in use
+			const JpegCompressor::Settings settings;
+			vector<Poco::SharedPtr<JpegCompressor>> compressors;
+			vector<vector<uchar>> parts;
+		};
+	}
+}
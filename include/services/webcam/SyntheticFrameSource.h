@@ -0,0 +1,54 @@
+//============================================================================
+// Name        : SyntheticFrameSource.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Generates test pattern frames without any capture hardware
+//============================================================================
+#pragma once
+#include "FrameSource.h"
+
+#include "Poco\Types.h"
+
+namespace services {
+	namespace webcam {
+		class SyntheticFrameSource : public FrameSource {
+		public:
+			enum Pattern {
+				PATTERN_BARS,
+				PATTERN_CHECKERBOARD,
+				PATTERN_GRADIENT
+			};
+
+			SyntheticFrameSource(int width = 1280, int height = 720, double fps = 15, Pattern pattern = PATTERN_BARS);
+			~SyntheticFrameSource();
+
+			bool Open();
+			void Close();
+			bool IsOpened();
+			bool Read(Mat& frame);
+			double GetFPS();
+			int GetWidth();
+			int GetHeight();
+			string GetName();
+
+			// maps "bars", "checkerboard" or "gradient" to a pattern, defaults to bars
+			static Pattern ParsePattern(const string& name);
+
+			// height in pixels of the binary frame counter strip at the bottom of each frame.
+			// The counter is drawn as 32 black/white cells, most significant bit first,
+			// so load tests can detect dropped or duplicated frames from the JPEG alone.
+			static const int COUNTER_STRIP_HEIGHT = 16;
+		private:
+			int width;
+			int height;
+			double fps;
+			Pattern pattern;
+			bool isOpened;
+			Poco::UInt32 frameCounter;
+			Mat background;
+
+			void RenderBackground();
+			void RenderCounterStrip(Mat& frame);
+		};
+	}
+}
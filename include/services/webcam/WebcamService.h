@@ -6,6 +6,19 @@
 //============================================================================
 #pragma once
 #include "..\..\shared\observer\Observable.h"
+#include "FrameSource.h"
+#include "EncodedFrame.h"
+#include "RawFrame.h"
+#include "CapturedFrame.h"
+#include "FrameSlot.h"
+#include "FrameRing.h"
+#include "Rendition.h"
+#include "StripedJpegEncoder.h"
+#include "EncodingGovernor.h"
+#include "StageStats.h"
+#include "BufferPool.h"
+#include "ProcessingGraph.h"
+#include "..\..\shared\queue\BoundedQueue.h"
 
 #include "opencv2\core\core.hpp"
 #include "opencv2\opencv.hpp"
@@ -14,7 +27,13 @@
 #include "Poco\Logger.h"
 #include "Poco\RWLock.h"
 #include "Poco\Mutex.h"
+#include "Poco\Clock.h"
+#include "Poco\Condition.h"
+#include "Poco\Event.h"
+#include "Poco\Types.h"
+#include "Poco\SharedPtr.h"
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -25,37 +44,154 @@ using Poco::Thread;
 using Poco::RunnableAdapter;
 using Poco::Logger;
 using Poco::Mutex;
+using Poco::SharedPtr;
 
 namespace services {
 	namespace webcam {
 		class WebcamService : public Observable < WebcamService > {
 		public:
+			struct Config {
+				Config() : queueSize(2), statsInterval(10), onDemand(true), releaseAfter(30000), encodeStripes(0), passthrough(false), nativeYUV(false), history(30) { }
+
+				int queueSize;       // raw frames buffered between capture and encode, oldest dropped first
+				int statsInterval;   // seconds between pipeline timing reports in the log, 0 disables them
+				bool onDemand;       // only encode while viewers are registered
+				int releaseAfter;    // ms without viewers after which the source is closed, 0 keeps it open
+				int encodeStripes;   // stripes encoded in parallel per frame, 0 uses all cores, 1 encodes on one thread
+				bool passthrough;    // publish JPEG delivered by the source as it is in renditions of source size
+				bool nativeYUV;      // capture YUV as the device delivers it and encode it without converting to BGR
+				int history;         // encoded frames kept per rendition for GetFrameAfter()
+				EncodingGovernor::Config governor; // automatic quality and frame rate reduction under load
+				JpegCompressor::Settings encoder;  // subsampling, Huffman and restart settings of all renditions
+				BufferPool::Config pool;           // recycled frame and JPEG memory
+				ProcessingGraph::Config stages;    // processing stages fed with every captured frame
+				vector<Rendition> renditions; // encoding ladder, the first one is the default. Empty means full resolution only
+			};
+
 			WebcamService();
+			WebcamService(FrameSource::Ptr source);
+			WebcamService(FrameSource::Ptr source, const Config& config);
 			~WebcamService();
 
 			bool StartRecording();
 			bool StopRecording();
-			Mat& GetLastImage();
-			vector<uchar>* GetModifiedImage();
-			void SetModifiedImage(Mat& image);
+			// latest captured frame, null before the first one. Never blocks the capture thread,
+			// the handle stays unchanged while newer frames are captured.
+			CapturedFrame::Ptr GetLatestFrame();
+			const vector<Rendition>& GetRenditions() const;
+			// index of the rendition with the given name, -1 if there is none
+			int FindRendition(const string& name) const;
+			// latest encoded frame of the default rendition, null before the first frame was encoded
+			EncodedFrame::Ptr GetModifiedImage();
+			// blocks until a frame of the default rendition newer than sequence was encoded or
+			// timeout (ms) expires. Returns null on timeout.
+			EncodedFrame::Ptr GetModifiedImage(Poco::UInt64 sequence, long timeout);
+			// latest encoded frame of a rendition, null if it was never encoded
+			EncodedFrame::Ptr GetModifiedImage(int rendition);
+			EncodedFrame::Ptr GetModifiedImage(int rendition, Poco::UInt64 sequence, long timeout);
+			// the frame of a rendition following sequence, from the history if it is older than the
+			// latest one. If it is no longer kept, the oldest kept frame is returned instead. Waits up
+			// to timeout (ms) for the next frame if there is none yet, returns null on timeout.
+			EncodedFrame::Ptr GetFrameAfter(int rendition, Poco::UInt64 sequence, long timeout);
+			// like GetFrameAfter(rendition, sequence, timeout) for the first frame captured after captured
+			EncodedFrame::Ptr GetFrameAfter(int rendition, const Poco::Timestamp& captured, long timeout);
+			// blocks until more than published frames were encoded over all renditions or
+			// timeout (ms) expires. Returns the current count.
+			Poco::UInt64 WaitForFrames(Poco::UInt64 published, long timeout);
+			// sequence of the latest frame of the default rendition, 0 means no frame yet
+			Poco::UInt64 GetFrameSequence();
+			// encodes frame in the given rendition and publishes it. A compressed frame of the
+			// rendition's size is published without re-encoding, otherwise it is decoded first.
+			// YUV frames are encoded without conversion. Returns false if encoding failed.
+			bool SetModifiedImage(int rendition, const CapturedFrame& frame);
+			// true while the recording threads run, also while suspended for lack of viewers
 			bool IsRecording();
+			// true while no frames are encoded because nobody is watching
+			bool IsSuspended();
+			// true while the source delivers JPEG that is forwarded without re-encoding
+			bool IsPassthrough();
+			// true while the source delivers YUV that is encoded without conversion to BGR
+			bool IsNativeYUV();
+			// viewers announce themselves so only watched renditions are encoded
+			void AddViewer(int rendition = 0);
+			void RemoveViewer(int rendition = 0);
+			// keeps a rendition encoded for duration (ms) without a registered viewer, for clients
+			// that poll frame by frame instead of streaming
+			void HoldViewer(int rendition, long duration);
+			int GetViewerCount();
+			int GetViewerCount(int rendition);
 			int GetFPS();
 			int GetDelay();
+			StageStats& GetCaptureStats();
+			StageStats& GetEncodeStats();
+			// time from taking a frame off the source until it is published, per encoded frame
+			StageStats& GetLatencyStats();
+			EncodingGovernor& GetGovernor();
+			// memory of captured frames and published JPEG, shared by all pipeline stages
+			BufferPool& GetBufferPool();
+			// overlay, analytics and other stages that get every captured frame on their own threads
+			ProcessingGraph& GetProcessingGraph();
 		private:
-			bool isRecording;
-			bool isModifiedAvailable;
+			// per rendition output, the frames are guarded by modifiedImgMutex,
+			// the encoding members are only used by the encoding thread
+			struct Output {
+				Output(const Rendition& rendition, int stripes, const JpegCompressor::Settings& settings, int history);
+
+				const Rendition rendition;
+				std::atomic<int> viewers;
+				std::atomic<Poco::Timestamp::TimeVal> heldUntil; // see HoldViewer()
+				FrameRing frames;           // the latest encoded frames, sequence 0 means no frame yet
+				Poco::Timestamp lastCaptured; // capture time of the last encoded frame, for the fps cap
+				Mat scaled;
+				StripedJpegEncoder encoder;
+				vector<uchar> buffer;       // taken from the pool before every encode
+				size_t lastSize;            // bytes of the last encoded frame
+			};
+
+			Config config;
+			BufferPool::Ptr pool;  // first, blocks handed out hold it until the last frame is gone
+			std::atomic<bool> isRecording;
+			std::atomic<int> viewers;
+			std::atomic<bool> isSuspended;
+			Poco::Event viewerAdded;
 			int fps;
 			int delay;
-			VideoCapture capture;
-			Mat lastImage;
-			vector<uchar> modifiedImage;
+			FrameSource::Ptr source;
+			Poco::Clock::ClockDiff frameInterval; //in us
+			FrameSlot latestFrame;
+			vector<SharedPtr<Output>> outputs;
 			Thread* recordingThread;
 			RunnableAdapter<WebcamService>* recordingAdapter;
-			Poco::Mutex lastImgMutex;
+			Thread* encodingThread;
+			RunnableAdapter<WebcamService>* encodingAdapter;
+			BoundedQueue<CapturedFrame::Ptr> rawFrames; // the same handles as latestFrame, decoded at most once
+			StageStats captureStats;
+			StageStats encodeStats;
+			StageStats latencyStats;
+			EncodingGovernor governor;
+			ProcessingGraph graph;
 			Poco::Mutex modifiedImgMutex;
-			vector<int> params;
+			Poco::Condition modifiedImgAvailable;
+			Poco::UInt64 published; //frames encoded over all renditions, guarded by modifiedImgMutex
 
+			// capture stage: reads and paces frames from the source
 			void RecordingCore();
+			// tracks idle time, releases and reopens the source. Returns false while no
+			// frames should be captured, the caller then skips the iteration.
+			bool UpdateDemand(Poco::Clock& idleSince);
+			// encode stage: turns queued raw frames into published JPEG frames
+			void EncodingCore();
+			// whether the output is watched and its fps cap allows a frame captured at captured
+			bool IsEncodingDue(int rendition, const Poco::Timestamp& captured);
+			// position is a sequence or a capture time, see FrameRing::GetAfter()
+			template<class Position>
+			EncodedFrame::Ptr WaitForFrameAfter(Output& output, const Position& position, long timeout);
+			// registered viewers or a hold, see HoldViewer()
+			bool IsWatched(int rendition);
+			bool IsWatched();
+			void LogStats();
+			// paces the recording thread at rate frames per second
+			void SetFrameRate(double rate);
 		};
 	}
 }
\ No newline at end of file
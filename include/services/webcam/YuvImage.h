@@ -0,0 +1,36 @@
+//============================================================================
+// Name        : YuvImage.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Planar YCbCr 4:2:0 frames in the I420 layout of OpenCV
+//============================================================================
+#pragma once
+
+#include "opencv2\core\core.hpp"
+
+using cv::Mat;
+
+namespace services {
+	namespace webcam {
+		// An I420 frame is one continuous CV_8UC1 Mat of height * 3 / 2 rows: the Y plane,
+		// then the Cb and Cr planes at half width and height. Width and height are even.
+		// cv::cvtColor(yuv, bgr, cv::COLOR_YUV2BGR_I420) converts it for processing.
+		class YuvImage {
+		public:
+			// size of the picture, not of the Mat
+			static cv::Size GetSize(const Mat& yuv);
+			static bool IsValid(const Mat& yuv);
+
+			// repacks packed 4:2:2 YUYV with row stride step, the chroma of two rows is averaged
+			static bool FromYUYV(const uchar* data, int width, int height, size_t step, Mat& yuv);
+			// splits the interleaved chroma plane of NV12
+			static bool FromNV12(const uchar* data, int width, int height, Mat& yuv);
+			// scales every plane with area interpolation, size has to be even
+			static void Resize(const Mat& src, const cv::Size& size, Mat& dst);
+
+			static const uchar* GetY(const Mat& yuv);
+			static const uchar* GetU(const Mat& yuv);
+			static const uchar* GetV(const Mat& yuv);
+		};
+	}
+}
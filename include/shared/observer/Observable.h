@@ -8,54 +8,75 @@
 #pragma once
 #include "IObserver.h"
 
+#include "Poco\Mutex.h"
+#include "Poco\SharedPtr.h"
+
+#include <algorithm>
 #include <vector>
 
 using namespace std;
 
+// Observers may be added and removed from any thread, also while Notify() runs. The list is
+// copied on every change and Notify() walks the copy that was current when it started, so an
+// observer can get one more Update() from a Notify() that overlaps its removal.
 template<class T>
 class Observable
 {
 public:
-	Observable() {
+	Observable() : observers(new Observers()) {
 	}
 
 	virtual ~Observable() {
-		observers.clear();
+		observers.reset();
 	}
 
 	bool AddObserver(IObserver<T> *observer) {
-		vector<IObserver<T> *>::iterator iter = find(observers.begin(), observers.end(), observer);
+		Poco::FastMutex::ScopedLock lock(mutex);
 		// observer exists already
-		if (iter != observers.end())
+		if (find(observers->begin(), observers->end(), observer) != observers->end())
 			return false;
 
-		observers.push_back(observer);
+		Poco::SharedPtr<Observers> changed = new Observers(*observers);
+		changed->push_back(observer);
+		observers = changed;
 		return true;
 	}
 
 	bool RemoveObserver(IObserver<T> *observer) {
-		vector<IObserver<T> *>::iterator iter = find(observers.begin(), observers.end(), observer);
+		Poco::FastMutex::ScopedLock lock(mutex);
+		typename Observers::const_iterator iter = find(observers->begin(), observers->end(), observer);
 
 		// observer could not be found
-		if (iter == observers.end()) {
+		if (iter == observers->end()) {
 			return false;
 		}
 
-		observers.erase(remove(observers.begin(), observers.end(), observer));
+		Poco::SharedPtr<Observers> changed = new Observers(*observers);
+		changed->erase(remove(changed->begin(), changed->end(), observer), changed->end());
+		observers = changed;
 		return true;
 	}
 
 	void Notify() {
-		if (observers.size() == 0) {
+		Poco::SharedPtr<Observers> current = GetObservers();
+		if (current->size() == 0) {
 			return;
 		}
 
-		vector<IObserver<T> *>::iterator iter;
-		for (iter = observers.begin(); iter != observers.end(); iter++) {
+		typename Observers::const_iterator iter;
+		for (iter = current->begin(); iter != current->end(); iter++) {
 			(*iter)->Update(static_cast<T *>(this));
 		}
 	}
 
 private:
-	vector<IObserver<T> *> observers;
+	typedef vector<IObserver<T> *> Observers;
+
+	Poco::SharedPtr<Observers> GetObservers() {
+		Poco::FastMutex::ScopedLock lock(mutex); //only guards the pointer, the list itself never changes
+		return observers;
+	}
+
+	Poco::FastMutex mutex;
+	Poco::SharedPtr<Observers> observers;
 };
@@ -0,0 +1,86 @@
+//============================================================================
+// Name        : BoundedQueue.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Fixed capacity blocking queue that drops the oldest element
+//               instead of blocking the producer when it is full
+//============================================================================
+#pragma once
+
+#include "Poco\Mutex.h"
+#include "Poco\Condition.h"
+#include "Poco\Types.h"
+
+#include <deque>
+
+template<class T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), dropped(0), woken(false) {
+	}
+
+	// never blocks, returns false if the oldest element had to be dropped to make room
+	bool Push(const T& item) {
+		Poco::Mutex::ScopedLock lock(mutex);
+		bool dropOldest = items.size() >= capacity;
+		if (dropOldest) {
+			items.pop_front();
+			++dropped;
+		}
+		items.push_back(item);
+		available.signal();
+		return !dropOldest;
+	}
+
+	// waits up to timeout ms for an element, returns false on timeout or after Wake()
+	bool Pop(T& item, long timeout) {
+		Poco::Mutex::ScopedLock lock(mutex);
+		while (items.empty()) {
+			if (woken || !available.tryWait(mutex, timeout)) {
+				woken = false;
+				return false;
+			}
+		}
+		item = items.front();
+		items.pop_front();
+		return true;
+	}
+
+	// releases a consumer blocked in Pop(), e.g. on shutdown
+	void Wake() {
+		Poco::Mutex::ScopedLock lock(mutex);
+		woken = true;
+		available.broadcast();
+	}
+
+	void Clear() {
+		Poco::Mutex::ScopedLock lock(mutex);
+		items.clear();
+	}
+
+	size_t Size() {
+		Poco::Mutex::ScopedLock lock(mutex);
+		return items.size();
+	}
+
+	size_t GetCapacity() const {
+		return capacity;
+	}
+
+	Poco::UInt64 GetDropped() {
+		Poco::Mutex::ScopedLock lock(mutex);
+		return dropped;
+	}
+
+private:
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+
+	const size_t capacity;
+	std::deque<T> items;
+	Poco::UInt64 dropped;
+	bool woken;
+	Poco::Mutex mutex;
+	Poco::Condition available;
+};
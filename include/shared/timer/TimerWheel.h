@@ -0,0 +1,129 @@
+//============================================================================
+// Name        : TimerWheel.h
+// Author      : ITM13
+// Version     : 1.0
+// Description : Hierarchical timer wheel scheduling many items on one thread
+//============================================================================
+#pragma once
+
+#include "Poco\Timestamp.h"
+#include "Poco\Types.h"
+
+#include <vector>
+
+// Items are filed by due tick into LEVELS wheels of SLOTS slots each. The first wheel
+// has one slot per tick, every slot of the next wheel spans a whole turn of the one
+// below. Scheduling and firing cost O(1) per item however many are pending. An item
+// moves down a wheel each time the slot it waits in comes round, so it is touched at
+// most LEVELS times. Not synchronized, the owner guards it.
+template<class T>
+class TimerWheel
+{
+public:
+	// tick is the resolution in us, items fire on the first Advance() at or after the
+	// start of the tick they are due in
+	explicit TimerWheel(Poco::Timestamp::TimeDiff tick, const Poco::Timestamp& start = Poco::Timestamp())
+		: tick(tick > 0 ? tick : 1), start(start), current(0), count(0), wheels(LEVELS * SLOTS) {
+	}
+
+	// items due beyond the range of the wheels, about 16.7 million ticks, fire at its end
+	void Schedule(const Poco::Timestamp& due, const T& item) {
+		Poco::UInt64 dueTick = ToTick(due);
+		// due already, fires with the next tick
+		if (dueTick <= current) {
+			dueTick = current + 1;
+		}
+		if (dueTick - current >= RANGE) {
+			dueTick = current + RANGE - 1;
+		}
+		Insert(Entry(dueTick, item));
+		++count;
+	}
+
+	// moves time forward to now and appends every item that became due to expired
+	void Advance(const Poco::Timestamp& now, std::vector<T>& expired) {
+		Poco::UInt64 target = ToTick(now);
+		if (count == 0) {
+			current = std::max(current, target);
+			return;
+		}
+		while (current < target && count > 0) {
+			++current;
+			// refill the first wheel from the coarser ones whenever it completes a turn
+			for (int level = 1; level < LEVELS && (current & ((static_cast<Poco::UInt64>(1) << (SLOT_BITS * level)) - 1)) == 0; level++) {
+				std::vector<Entry> cascading;
+				cascading.swap(Slot(level, Index(current, level)));
+				for (auto& entry : cascading) {
+					Insert(entry);
+				}
+			}
+
+			std::vector<Entry>& due = Slot(0, Index(current, 0));
+			for (auto& entry : due) {
+				expired.push_back(entry.item);
+			}
+			count -= due.size();
+			due.clear();
+		}
+		current = std::max(current, target);
+	}
+
+	size_t Size() const {
+		return count;
+	}
+
+	bool IsEmpty() const {
+		return count == 0;
+	}
+
+	void Clear() {
+		for (auto& slot : wheels) {
+			slot.clear();
+		}
+		count = 0;
+	}
+
+private:
+	TimerWheel(const TimerWheel&);
+	TimerWheel& operator=(const TimerWheel&);
+
+	static const int SLOT_BITS = 6;
+	static const int SLOTS = 1 << SLOT_BITS;
+	static const int LEVELS = 4;
+	static const Poco::UInt64 RANGE = static_cast<Poco::UInt64>(1) << (SLOT_BITS * LEVELS);
+
+	struct Entry {
+		Entry(Poco::UInt64 tick, const T& item) : tick(tick), item(item) { }
+
+		Poco::UInt64 tick;
+		T item;
+	};
+
+	Poco::UInt64 ToTick(const Poco::Timestamp& time) const {
+		return time > start ? static_cast<Poco::UInt64>((time - start) / tick) : 0;
+	}
+
+	static int Index(Poco::UInt64 tick, int level) {
+		return static_cast<int>((tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+	}
+
+	std::vector<Entry>& Slot(int level, int index) {
+		return wheels[level * SLOTS + index];
+	}
+
+	// the coarsest wheel needed is the one whose slots span the distance to the due tick
+	void Insert(const Entry& entry) {
+		Poco::UInt64 distance = entry.tick - current;
+		int level = 0;
+		while (level + 1 < LEVELS && distance >= (static_cast<Poco::UInt64>(1) << (SLOT_BITS * (level + 1)))) {
+			++level;
+		}
+		Slot(level, Index(entry.tick, level)).push_back(entry);
+	}
+
+	const Poco::Timestamp::TimeDiff tick;
+	const Poco::Timestamp start;
+	Poco::UInt64 current;   // ticks since start that were processed
+	size_t count;
+	std::vector<std::vector<Entry>> wheels;
+};
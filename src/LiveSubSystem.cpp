@@ -1,13 +1,26 @@
 #include "Poco/Util/Application.h"
 #include "Poco/Exception.h"
+#include "Poco/StringTokenizer.h"
 #include "LiveSubSystem.h"
 #include "Network/WebServerDispatcher.h"
 #include "Network/WebServerRequestHandlerFactory.h"
 #include "Network/MediaTypeMapper.h"
 #include "services/webcam/WebcamService.h"
+#include "services/webcam/CameraFrameSource.h"
+#include "services/webcam/SyntheticFrameSource.h"
+#include "services/webcam/ReplayFrameSource.h"
 #include "Network/router/VideoStreamingRequestHandlerFactory.h"
+#include "Network/router/WebcamStatusRequestHandlerFactory.h"
+#include "Network/router/FrameRequestHandlerFactory.h"
+#include "Network/router/SnapshotRequestHandlerFactory.h"
+#include "Network/router/WebSocketStreamRequestHandlerFactory.h"
 
 using services::webcam::WebcamService;
+using services::webcam::FrameSource;
+using services::webcam::CameraFrameSource;
+using services::webcam::SyntheticFrameSource;
+using services::webcam::ReplayFrameSource;
+using services::webcam::Rendition;
 
 namespace LiveStream {
 
@@ -59,15 +72,93 @@ void LiveSubSystem::initialize(Poco::Util::Application& app)
     vPath.resource = app.config().getString("web.server.Public", "build/");
     _webServerDispatcher->addVirtualPath(vPath);
 
-    _webcamService = new WebcamService();
+    WebcamService::Config webcamConfig;
+    webcamConfig.queueSize = app.config().getInt("webcam.pipeline.queueSize", webcamConfig.queueSize);
+    webcamConfig.statsInterval = app.config().getInt("webcam.pipeline.statsInterval", webcamConfig.statsInterval);
+    webcamConfig.onDemand = app.config().getBool("webcam.pipeline.onDemand", webcamConfig.onDemand);
+    webcamConfig.releaseAfter = app.config().getInt("webcam.pipeline.releaseAfter", webcamConfig.releaseAfter);
+    webcamConfig.encodeStripes = app.config().getInt("webcam.pipeline.encodeStripes", webcamConfig.encodeStripes);
+    webcamConfig.passthrough = app.config().getBool("webcam.pipeline.passthrough", webcamConfig.passthrough);
+    webcamConfig.nativeYUV = app.config().getBool("webcam.pipeline.nativeYUV", webcamConfig.nativeYUV);
+    webcamConfig.history = app.config().getInt("webcam.pipeline.history", webcamConfig.history);
+    webcamConfig.renditions = createRenditions(app);
+    webcamConfig.encoder.subsampling = services::webcam::JpegCompressor::ParseSubsampling(
+        app.config().getString("webcam.encoder.subsampling", "420"));
+    webcamConfig.encoder.optimizeHuffman = app.config().getBool("webcam.encoder.optimizeHuffman", webcamConfig.encoder.optimizeHuffman);
+    webcamConfig.encoder.restartRows = app.config().getInt("webcam.encoder.restartRows", webcamConfig.encoder.restartRows);
+    webcamConfig.pool.maxIdle = app.config().getInt("webcam.pool.maxIdle", webcamConfig.pool.maxIdle);
+    webcamConfig.pool.hugePages = app.config().getBool("webcam.pool.hugePages", webcamConfig.pool.hugePages);
+    webcamConfig.stages.queueSize = app.config().getInt("webcam.stages.queueSize", webcamConfig.stages.queueSize);
+    webcamConfig.governor.enabled = app.config().getBool("webcam.governor.enabled", webcamConfig.governor.enabled);
+    webcamConfig.governor.cpuBudget = app.config().getDouble("webcam.governor.cpuBudget", webcamConfig.governor.cpuBudget);
+    webcamConfig.governor.minQuality = app.config().getInt("webcam.governor.minQuality", webcamConfig.governor.minQuality);
+    webcamConfig.governor.qualityStep = app.config().getInt("webcam.governor.qualityStep", webcamConfig.governor.qualityStep);
+    webcamConfig.governor.minFps = app.config().getDouble("webcam.governor.minFps", webcamConfig.governor.minFps);
+    webcamConfig.governor.period = app.config().getInt("webcam.governor.period", webcamConfig.governor.period);
+    webcamConfig.governor.highLoad = app.config().getDouble("webcam.governor.highLoad", webcamConfig.governor.highLoad);
+    webcamConfig.governor.lowLoad = app.config().getDouble("webcam.governor.lowLoad", webcamConfig.governor.lowLoad);
+    webcamConfig.governor.holdPeriods = app.config().getInt("webcam.governor.holdPeriods", webcamConfig.governor.holdPeriods);
+
+    _webcamService = new WebcamService(createFrameSource(app), webcamConfig);
     _webcamService->StartRecording();
 
     WebServerDispatcher::VirtualPath webcam;
     webcam.cors.allowOrigin = "*";
     webcam.cors.enable = true;
     webcam.path = "/api/webcam";
-    webcam.pFactory = new infrastructure::video_streaming::VideoStreamingRequestHandlerFactory(_webcamService);
+    infrastructure::video_streaming::MjpegBroadcaster::Config broadcastConfig;
+    broadcastConfig.reactors = app.config().getInt("webcam.stream.reactors", broadcastConfig.reactors);
+    broadcastConfig.transport = infrastructure::video_streaming::MjpegBroadcaster::ParseTransport(
+        app.config().getString("webcam.stream.transport", "write"));
+    broadcastConfig.adaptive = app.config().getBool("webcam.stream.adaptive", broadcastConfig.adaptive);
+    broadcastConfig.burst = app.config().getInt("webcam.stream.burst", broadcastConfig.burst);
+    broadcastConfig.pacingTick = app.config().getInt("webcam.stream.pacingTick", broadcastConfig.pacingTick);
+    broadcastConfig.session.queueSize = app.config().getInt("webcam.stream.queueSize", broadcastConfig.session.queueSize);
+    broadcastConfig.session.maxFrameAge = app.config().getInt("webcam.stream.maxFrameAge", broadcastConfig.session.maxFrameAge);
+    broadcastConfig.session.evictAfter = app.config().getInt("webcam.stream.evictAfter", broadcastConfig.session.evictAfter);
+    _broadcaster = new infrastructure::video_streaming::MjpegBroadcaster(_webcamService, broadcastConfig);
+    _broadcaster->Start();
+
+    webcam.pFactory = new infrastructure::video_streaming::VideoStreamingRequestHandlerFactory(_webcamService, _broadcaster);
     _webServerDispatcher->addVirtualPath(webcam);
+
+    WebServerDispatcher::VirtualPath webcamStatus;
+    webcamStatus.cors.allowOrigin = "*";
+    webcamStatus.cors.enable = true;
+    webcamStatus.path = "/api/webcam/status";
+    webcamStatus.pFactory = new infrastructure::video_streaming::WebcamStatusRequestHandlerFactory(_webcamService, _broadcaster);
+    _webServerDispatcher->addVirtualPath(webcamStatus);
+
+    WebServerDispatcher::VirtualPath webcamFrame;
+    webcamFrame.cors.allowOrigin = "*";
+    webcamFrame.cors.enable = true;
+    webcamFrame.path = "/api/webcam/frame";
+    infrastructure::video_streaming::FrameRequestHandlerFactory::Config frameConfig;
+    frameConfig.maxWait = app.config().getInt("webcam.frame.maxWait", frameConfig.maxWait);
+    frameConfig.hold = app.config().getInt("webcam.frame.hold", frameConfig.hold);
+    webcamFrame.pFactory = new infrastructure::video_streaming::FrameRequestHandlerFactory(_webcamService, frameConfig);
+    _webServerDispatcher->addVirtualPath(webcamFrame);
+
+    WebServerDispatcher::VirtualPath webcamSnapshot;
+    webcamSnapshot.cors.allowOrigin = "*";
+    webcamSnapshot.cors.enable = true;
+    webcamSnapshot.path = "/api/webcam/snapshot.jpg";
+    infrastructure::video_streaming::SnapshotRequestHandlerFactory::Config snapshotConfig;
+    snapshotConfig.maxAge = app.config().getInt("webcam.snapshot.maxAge", snapshotConfig.maxAge);
+    snapshotConfig.maxWait = app.config().getInt("webcam.snapshot.maxWait", snapshotConfig.maxWait);
+    snapshotConfig.hold = app.config().getInt("webcam.snapshot.hold", snapshotConfig.hold);
+    webcamSnapshot.pFactory = new infrastructure::video_streaming::SnapshotRequestHandlerFactory(_webcamService, snapshotConfig);
+    _webServerDispatcher->addVirtualPath(webcamSnapshot);
+
+    WebServerDispatcher::VirtualPath webcamWebSocket;
+    webcamWebSocket.path = "/api/webcam/ws";
+    infrastructure::video_streaming::WebSocketStreamRequestHandlerFactory::Config webSocketConfig;
+    webSocketConfig.window = app.config().getInt("webcam.ws.window", webSocketConfig.window);
+    webSocketConfig.maxWindow = app.config().getInt("webcam.ws.maxWindow", webSocketConfig.maxWindow);
+    webSocketConfig.ackTimeout = app.config().getInt("webcam.ws.ackTimeout", webSocketConfig.ackTimeout);
+    webSocketConfig.maxClients = app.config().getInt("webcam.ws.maxClients", webSocketConfig.maxClients);
+    webcamWebSocket.pFactory = new infrastructure::video_streaming::WebSocketStreamRequestHandlerFactory(_webcamService, webSocketConfig);
+    _webServerDispatcher->addVirtualPath(webcamWebSocket);
     
 
     _httpServer = new Poco::Net::HTTPServer(new WebServerRequestHandlerFactory(*_webServerDispatcher, false), _webServerDispatcher->threadPool(), 
@@ -77,6 +168,65 @@ void LiveSubSystem::initialize(Poco::Util::Application& app)
 	app.logger().information("Startup complete.");
 }
 	
+FrameSource::Ptr LiveSubSystem::createFrameSource(Poco::Util::Application& app)
+{
+    std::string type = app.config().getString("webcam.source", "camera");
+    double fps = app.config().getDouble("webcam.source.fps", 15);
+    int width = app.config().getInt("webcam.source.width", 0);
+    int height = app.config().getInt("webcam.source.height", 0);
+
+    if (type == "synthetic")
+    {
+        return new SyntheticFrameSource(width > 0 ? width : 1280, height > 0 ? height : 720, fps,
+            SyntheticFrameSource::ParsePattern(app.config().getString("webcam.source.pattern", "bars")));
+    }
+    else if (type == "replay")
+    {
+        return new ReplayFrameSource(app.config().getString("webcam.source.path"), fps,
+            app.config().getBool("webcam.source.loop", true));
+    }
+    else if (type != "camera")
+    {
+        app.logger().warning("Unknown webcam.source \"" + type + "\", using camera.");
+    }
+    return new CameraFrameSource(app.config().getInt("webcam.source.device", 0), fps, width, height,
+        app.config().getBool("webcam.source.lowLatency", false));
+}
+
+std::vector<Rendition> LiveSubSystem::createRenditions(Poco::Util::Application& app)
+{
+    static const Rendition presets[] = {
+        Rendition("full", 0, 0, 100, 0),
+        Rendition("720p", 0, 720, 85, 0),
+        Rendition("360p", 0, 360, 75, 0),
+        Rendition("thumbnail", 0, 180, 70, 2)
+    };
+
+    std::vector<Rendition> renditions;
+    Poco::StringTokenizer names(app.config().getString("webcam.renditions", "full,720p,360p,thumbnail"), ",",
+        Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+    for (const auto& name : names)
+    {
+        Rendition rendition;
+        rendition.name = name;
+        for (const auto& preset : presets)
+        {
+            if (preset.name == name)
+            {
+                rendition = preset;
+            }
+        }
+
+        std::string prefix = "webcam.rendition." + name + ".";
+        rendition.width = app.config().getInt(prefix + "width", rendition.width);
+        rendition.height = app.config().getInt(prefix + "height", rendition.height);
+        rendition.quality = std::min(100, std::max(1, app.config().getInt(prefix + "quality", rendition.quality)));
+        rendition.fps = app.config().getDouble(prefix + "fps", rendition.fps);
+        renditions.push_back(rendition);
+    }
+    return renditions;
+}
+
 void LiveSubSystem::uninitialize()
 {   
     if(_webcamService->IsRecording()) {
@@ -84,6 +234,7 @@ void LiveSubSystem::uninitialize()
     }
     _httpServer->stop();
     delete _httpServer;
+    _broadcaster->Stop();
     Poco::Util::Application::instance().logger().information("Shutdown complete.");
 	
 }
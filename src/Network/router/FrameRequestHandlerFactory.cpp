@@ -0,0 +1,118 @@
+//============================================================================
+// Name        : FrameRequestHandlerFactory.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Single encoded frames by sequence under /api/webcam/frame, with long polling
+//============================================================================
+#include "Network/router/FrameRequestHandlerFactory.h"
+
+#include "Poco\URI.h"
+#include "Poco\NumberParser.h"
+#include "Poco\NumberFormatter.h"
+
+#include <algorithm>
+
+using Poco::Net::HTTPResponse;
+using services::webcam::EncodedFrame;
+
+namespace infrastructure {
+	namespace video_streaming {
+		FrameRequestHandlerFactory::FrameRequestHandlerFactory(SharedPtr<WebcamService> webcamService, const Config& config)
+			: webcamService(webcamService), config(config) { }
+
+		FrameRequestHandlerFactory::~FrameRequestHandlerFactory() {
+			//do not delete, since it is a shared pointer
+			webcamService = nullptr;
+		}
+
+		HTTPRequestHandler* FrameRequestHandlerFactory::createRequestHandler(const HTTPServerRequest& request) {
+			return new FrameRequestHandler(webcamService, config);
+		}
+
+		FrameRequestHandler::FrameRequestHandler(SharedPtr<WebcamService> webcamService, const FrameRequestHandlerFactory::Config& config)
+			: webcamService(webcamService), config(config) { }
+
+		FrameRequestHandler::~FrameRequestHandler() {
+			//do not delete, since it is a shared pointer
+			webcamService = nullptr;
+		}
+
+		void FrameRequestHandler::handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+			response.set("Cache-Control", "no-cache, private");
+
+			if (!webcamService->IsRecording()) {
+				response.setStatus(HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
+				response.send();
+				return;
+			}
+
+			// ?after=<sequence> the frame following it, ?since=<us since epoch> the first one captured
+			// later, neither means the latest frame. ?timeout=<ms> up to maxWait, ?rendition=<name>
+			int rendition = 0;
+			bool hasAfter = false;
+			bool hasSince = false;
+			Poco::UInt64 after = 0;
+			Poco::Int64 since = 0;
+			long timeout = config.maxWait;
+			Poco::URI::QueryParameters parameters = Poco::URI(request.getURI()).getQueryParameters();
+			for (auto& parameter : parameters) {
+				bool valid = true;
+				if (parameter.first == "rendition") {
+					rendition = webcamService->FindRendition(parameter.second);
+					valid = rendition >= 0;
+				}
+				else if (parameter.first == "after") {
+					hasAfter = valid = Poco::NumberParser::tryParseUnsigned64(parameter.second, after);
+				}
+				else if (parameter.first == "since") {
+					hasSince = valid = Poco::NumberParser::tryParse64(parameter.second, since);
+				}
+				else if (parameter.first == "timeout") {
+					int value;
+					valid = Poco::NumberParser::tryParse(parameter.second, value) && value >= 0;
+					timeout = valid ? std::min(static_cast<long>(value), config.maxWait) : timeout;
+				}
+				if (!valid) {
+					response.setStatusAndReason(HTTPResponse::HTTP_BAD_REQUEST);
+					response.setContentType("text/plain");
+					response.send() << "Invalid " << parameter.first << " " << parameter.second;
+					return;
+				}
+			}
+
+			// polls do not register as viewers, the hold keeps the rendition encoded until the next one
+			webcamService->HoldViewer(rendition, timeout + config.hold);
+
+			EncodedFrame::Ptr frame;
+			EncodedFrame::Ptr latest = webcamService->GetModifiedImage(rendition);
+			if (hasSince) {
+				frame = webcamService->GetFrameAfter(rendition, Poco::Timestamp(since), timeout);
+			}
+			else if (hasAfter && (!latest || after <= latest->GetSequence())) {
+				frame = webcamService->GetFrameAfter(rendition, after, timeout);
+			}
+			else {
+				// first poll, or a sequence from before a restart of the service
+				frame = webcamService->GetModifiedImage(rendition, 0, timeout);
+			}
+
+			if (!frame) {
+				// nothing new within timeout, the client asks again with the same position
+				response.setStatus(HTTPResponse::HTTP_NO_CONTENT);
+				response.set("X-Frame-Sequence", Poco::NumberFormatter::format(hasAfter ? after : 0));
+				response.send();
+				return;
+			}
+
+			response.set("X-Frame-Sequence", Poco::NumberFormatter::format(frame->GetSequence()));
+			response.set("X-Frame-Timestamp", Poco::NumberFormatter::format(frame->GetTimestamp().epochMicroseconds()));
+			if (hasAfter && frame->GetSequence() > after + 1) {
+				// the frames in between were no longer kept
+				response.set("X-Frames-Skipped", Poco::NumberFormatter::format(frame->GetSequence() - after - 1));
+			}
+			response.setContentType("image/jpeg");
+			response.setContentLength(static_cast<std::streamsize>(frame->GetSize()));
+			response.sendBuffer(frame->GetData(), frame->GetSize());
+		}
+	}
+}
@@ -0,0 +1,409 @@
+//============================================================================
+// Name        : MjpegBroadcaster.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Fans encoded frames out to all MJPEG viewers using a few
+//               SocketReactor threads instead of one thread per viewer
+//============================================================================
+#include "Network/router/MjpegBroadcaster.h"
+
+#include "Poco\Logger.h"
+#include "Poco\String.h"
+
+#include <algorithm>
+
+using Poco::Logger;
+
+namespace infrastructure {
+	namespace video_streaming {
+		namespace {
+			const long FRAME_WAIT_TIMEOUT = 500; //in ms
+			const long REACTOR_TIMEOUT = 20000; //in us, bounds the latency of handler changes on poll based platforms
+			const Poco::Timestamp::TimeDiff ADAPT_PERIOD = 1000000; //in us between rendition checks of a viewer
+			const Poco::Timestamp::TimeDiff DOWN_HOLD = 2000000; //in us after a switch before stepping down again
+			const Poco::Timestamp::TimeDiff UP_HOLD = 10000000; //in us after a switch before trying a larger rendition
+			const Poco::Timestamp::TimeDiff MAX_PART_GAP = 2000000; //in us, longer gaps mean the rendition was not encoded
+			const double DOWN_MARGIN = 0.9; //step down when the throughput covers less than this share of the rendition
+			const double UP_MARGIN = 1.3; //step up only with this much headroom over the larger rendition
+			const double UNKNOWN_STEP = 3; //assumed size ratio to a larger rendition that is not encoded right now
+			const double LOAD_SMOOTHING = 0.1;
+			const double MAX_PACED_INTERVAL = 3600; //in s, slower caps are raised to one frame per hour
+		}
+
+		MjpegBroadcaster::MjpegBroadcaster(SharedPtr<WebcamService> webcamService, const Config& config)
+			: webcamService(webcamService), config(config), useSplice(false), nextReactor(0), firstFrameStats("time to first frame"),
+			pacingWheel(static_cast<Poco::Timestamp::TimeDiff>(config.pacingTick > 0 ? config.pacingTick : 1) * 1000), isRunning(false),
+			broadcastThread("MjpegBroadcast"), broadcastAdapter(*this, &MjpegBroadcaster::BroadcastCore),
+			pacingThread("MjpegPacing"), pacingAdapter(*this, &MjpegBroadcaster::PacingCore) {
+			if (config.transport == TRANSPORT_SPLICE) {
+				useSplice = SplicePipe::IsSupported();
+				if (!useSplice) {
+					Logger::get("VideoStreamingRequestHandler").warning("splice transport is not supported on this platform, falling back to write");
+				}
+			}
+
+			size_t renditions = webcamService->GetRenditions().size();
+			sessions.resize(renditions);
+			lastParts.resize(renditions);
+			loads.resize(renditions);
+		}
+
+		MjpegBroadcaster::~MjpegBroadcaster() {
+			Stop();
+		}
+
+		void MjpegBroadcaster::Start() {
+			if (isRunning) {
+				return;
+			}
+
+			int count = config.reactors > 0 ? config.reactors : 1;
+			for (int i = 0; i < count; i++) {
+				reactors.push_back(new Reactor(Poco::Timespan(REACTOR_TIMEOUT)));
+			}
+
+			isRunning = true;
+			broadcastThread.start(broadcastAdapter);
+			pacingThread.start(pacingAdapter);
+
+			Logger::get("VideoStreamingRequestHandler").information("MJPEG broadcaster started with " + std::to_string(count) + " reactor threads, " +
+				(useSplice ? "splice" : "write") + " transport");
+		}
+
+		void MjpegBroadcaster::Stop() {
+			if (!isRunning) {
+				return;
+			}
+
+			isRunning = false;
+			pacingWake.set();
+			broadcastThread.join();
+			pacingThread.join();
+
+			{
+				// sessions unregister from their reactor while it is still alive
+				Poco::FastMutex::ScopedLock lock(sessionsMutex);
+				for (size_t rendition = 0; rendition < sessions.size(); rendition++) {
+					for (auto& viewer : sessions[rendition]) {
+						viewer.session->Close();
+						webcamService->RemoveViewer(static_cast<int>(rendition));
+					}
+					sessions[rendition].clear();
+					lastParts[rendition].reset();
+				}
+				pacingWheel.Clear();
+			}
+
+			// destroying a ParallelSocketReactor stops and joins its thread
+			reactors.clear();
+		}
+
+		void MjpegBroadcaster::AddClient(const StreamSocket& socket, int rendition, bool adaptive, double fps, const Poco::Timestamp& requested) {
+			Poco::FastMutex::ScopedLock lock(sessionsMutex);
+			if (!isRunning || reactors.empty() || rendition < 0 || rendition >= static_cast<int>(sessions.size())) {
+				StreamSocket(socket).close();
+				return;
+			}
+
+			Reactor& reactor = *reactors[nextReactor++ % reactors.size()];
+			MjpegSession::Ptr session = new MjpegSession(socket, reactor, config.session, requested);
+			session->Start();
+
+			Viewer viewer;
+			viewer.session = session;
+			viewer.ceiling = rendition;
+			viewer.adaptive = adaptive;
+			viewer.lastLost = 0;
+			viewer.firstFrameSeen = false;
+			webcamService->AddViewer(rendition);
+
+			// the pipeline may be suspended or the camera still opening, the cached frames keep the
+			// viewer from staring at nothing. Written on this thread, before the reactor polls the socket
+			vector<MjpegPart::Ptr> parts = GetRecentParts(rendition);
+			session->Prime(parts);
+			CheckFirstFrame(viewer);
+
+			if (fps > 0) {
+				// the grid starts with the primed frame, the broadcast thread leaves this viewer to the wheel
+				viewer.pacing = new Pacing();
+				viewer.pacing->session = session;
+				viewer.pacing->rendition = rendition;
+				viewer.pacing->interval = static_cast<Poco::Timestamp::TimeDiff>(std::min(1 / fps, MAX_PACED_INTERVAL) * 1000000);
+				viewer.pacing->due += viewer.pacing->interval;
+				viewer.pacing->closed = false;
+				if (!parts.empty()) {
+					viewer.pacing->lastSent = parts.back();
+				}
+				bool wasIdle = pacingWheel.IsEmpty();
+				pacingWheel.Schedule(viewer.pacing->due, viewer.pacing);
+				if (wasIdle) {
+					pacingWake.set();
+				}
+			}
+			sessions[rendition].push_back(viewer);
+		}
+
+		vector<MjpegPart::Ptr> MjpegBroadcaster::GetRecentParts(int rendition) {
+			vector<MjpegPart::Ptr> parts;
+			if (config.burst <= 0) {
+				return parts;
+			}
+
+			EncodedFrame::Ptr latest = webcamService->GetModifiedImage(rendition);
+			if (latest.isNull()) {
+				// any picture is better than none, MJPEG viewers take frames of changing size.
+				// Smaller renditions first, they reach the client sooner
+				int count = static_cast<int>(lastParts.size());
+				for (int distance = 1; distance < count; distance++) {
+					for (int other : { rendition + distance, rendition - distance }) {
+						if (other >= 0 && other < count && !lastParts[other].isNull()) {
+							parts.push_back(lastParts[other]);
+							return parts;
+						}
+					}
+				}
+				return parts;
+			}
+
+			// older frames from the history only while they are fresh, a burst of stale ones would replay old motion
+			Poco::UInt64 sequence = latest->GetSequence() > static_cast<Poco::UInt64>(config.burst) ? latest->GetSequence() - config.burst : 0;
+			for (EncodedFrame::Ptr frame = webcamService->GetFrameAfter(rendition, sequence, 0); !frame.isNull() && frame->GetSequence() < latest->GetSequence();
+				frame = webcamService->GetFrameAfter(rendition, frame->GetSequence(), 0)) {
+				if (config.session.maxFrameAge <= 0 || !frame->GetTimestamp().isElapsed(static_cast<Poco::Timestamp::TimeDiff>(config.session.maxFrameAge) * 1000)) {
+					// written once to this viewer, not worth a pipe for splicing
+					parts.push_back(new MjpegPart(frame, config.session.boundary, false));
+				}
+			}
+			const MjpegPart::Ptr& last = lastParts[rendition];
+			parts.push_back(!last.isNull() && last->GetFrame()->GetSequence() == latest->GetSequence() ? last : new MjpegPart(latest, config.session.boundary, false));
+			return parts;
+		}
+
+		void MjpegBroadcaster::CheckFirstFrame(Viewer& viewer) {
+			if (viewer.firstFrameSeen) {
+				return;
+			}
+			Poco::Timestamp::TimeDiff firstFrame = viewer.session->GetStats().firstFrame;
+			if (firstFrame > 0) {
+				viewer.firstFrameSeen = true;
+				firstFrameStats.Record(firstFrame);
+				Logger::get("VideoStreamingRequestHandler").information("Client " + viewer.session->GetClientAddress().toString() +
+					" got its first frame after " + std::to_string(firstFrame / 1000) + " ms");
+			}
+		}
+
+		StageStats& MjpegBroadcaster::GetFirstFrameStats() {
+			return firstFrameStats;
+		}
+
+		size_t MjpegBroadcaster::GetClientCount() {
+			Poco::FastMutex::ScopedLock lock(sessionsMutex);
+			size_t count = 0;
+			for (auto& viewers : sessions) {
+				count += viewers.size();
+			}
+			return count;
+		}
+
+		size_t MjpegBroadcaster::GetPacedClientCount() {
+			Poco::FastMutex::ScopedLock lock(sessionsMutex);
+			return pacingWheel.Size();
+		}
+
+		const string& MjpegBroadcaster::GetBoundary() const {
+			return config.session.boundary;
+		}
+
+		bool MjpegBroadcaster::IsAdaptive() const {
+			return config.adaptive;
+		}
+
+		MjpegBroadcaster::Transport MjpegBroadcaster::ParseTransport(const string& name) {
+			if (Poco::toLower(name) == "splice") {
+				return TRANSPORT_SPLICE;
+			}
+			return TRANSPORT_WRITE;
+		}
+
+		void MjpegBroadcaster::BroadcastCore() {
+			Poco::UInt64 published = 0;
+			vector<Poco::UInt64> sent(sessions.size(), 0);
+			vector<MjpegPart::Ptr> parts(sessions.size());
+			vector<std::pair<Viewer, int>> moves;
+
+			while (isRunning) {
+				published = webcamService->WaitForFrames(published, FRAME_WAIT_TIMEOUT);
+
+				// serialized once per rendition, every session of it sends the same part
+				for (size_t rendition = 0; rendition < parts.size(); rendition++) {
+					parts[rendition].reset();
+					EncodedFrame::Ptr frame = webcamService->GetModifiedImage(static_cast<int>(rendition));
+					if (!frame.isNull() && frame->GetSequence() > sent[rendition]) {
+						sent[rendition] = frame->GetSequence();
+						if (frame->GetSize() > 0) {
+							parts[rendition] = new MjpegPart(frame, config.session.boundary, useSplice);
+
+							RenditionLoad& load = loads[rendition];
+							Poco::Timestamp::TimeDiff gap = load.lastPart.elapsed();
+							if (load.partBytes > 0 && gap < MAX_PART_GAP) {
+								load.partInterval = load.partInterval == 0 ? gap : load.partInterval + (gap - load.partInterval) * LOAD_SMOOTHING;
+							}
+							load.partBytes = load.partBytes == 0 ? frame->GetSize() : load.partBytes + (frame->GetSize() - load.partBytes) * LOAD_SMOOTHING;
+							load.lastPart.update();
+						}
+					}
+				}
+
+				Poco::FastMutex::ScopedLock lock(sessionsMutex);
+				for (size_t rendition = 0; rendition < parts.size(); rendition++) {
+					MjpegPart::Ptr& part = parts[rendition];
+					vector<Viewer>& viewers = sessions[rendition];
+					if (!part.isNull()) {
+						lastParts[rendition] = part;
+					}
+					// also runs on timeouts, so viewers are released while no frames are encoded
+					for (size_t i = 0; i < viewers.size();) {
+						Viewer& viewer = viewers[i];
+						int target = viewer.session->IsClosed() ? -1 : Adapt(viewer, static_cast<int>(rendition));
+						if (target != static_cast<int>(rendition)) {
+							if (target >= 0) {
+								moves.push_back(std::make_pair(viewer, target));
+							}
+							else if (!viewer.pacing.isNull()) {
+								viewer.pacing->closed = true;
+							}
+							// order does not matter, move the last session into the gap
+							viewers[i] = viewers.back();
+							viewers.pop_back();
+							webcamService->RemoveViewer(static_cast<int>(rendition));
+							continue;
+						}
+						if (!part.isNull() && viewer.pacing.isNull()) {
+							Offer(viewer, part);
+						}
+						CheckFirstFrame(viewer);
+						++i;
+					}
+				}
+
+				// a moved viewer gets the next frame of its new rendition
+				for (auto& move : moves) {
+					Logger::get("VideoStreamingRequestHandler").information("Client " + move.first.session->GetClientAddress().toString() +
+						" switched to rendition " + webcamService->GetRenditions()[move.second].name + " at " +
+						std::to_string(static_cast<Poco::UInt64>(move.first.session->GetThroughput() / 1024)) + " KiB/s");
+					if (!move.first.pacing.isNull()) {
+						move.first.pacing->rendition = move.second;
+					}
+					sessions[move.second].push_back(move.first);
+					webcamService->AddViewer(move.second);
+				}
+				moves.clear();
+			}
+		}
+
+		void MjpegBroadcaster::PacingCore() {
+			vector<SharedPtr<Pacing>> expired;
+
+			while (isRunning) {
+				bool idle;
+				{
+					Poco::FastMutex::ScopedLock lock(sessionsMutex);
+					Poco::Timestamp now;
+					pacingWheel.Advance(now, expired);
+					for (auto& pacing : expired) {
+						if (!pacing->closed) {
+							SendPaced(*pacing, now);
+							pacingWheel.Schedule(pacing->due, pacing);
+						}
+					}
+					expired.clear();
+					idle = pacingWheel.IsEmpty();
+				}
+
+				// one thread for all paced viewers, it only ticks while any of them is connected
+				if (idle) {
+					pacingWake.tryWait(FRAME_WAIT_TIMEOUT);
+				}
+				else {
+					Poco::Thread::sleep(config.pacingTick > 0 ? config.pacingTick : 1);
+				}
+			}
+		}
+
+		void MjpegBroadcaster::SendPaced(Pacing& pacing, const Poco::Timestamp& now) {
+			// a frame already sent is not repeated, the viewer keeps showing it until the next one
+			const MjpegPart::Ptr& part = lastParts[pacing.rendition];
+			if (!part.isNull() && part != pacing.lastSent) {
+				pacing.session->Enqueue(part);
+				pacing.lastSent = part;
+			}
+
+			// the next send stays on the grid however late this tick ran, so frames go out evenly
+			// spaced. Only a viewer a whole interval behind, e.g. after a stall, starts a new grid
+			pacing.due += pacing.interval;
+			if (pacing.due <= now) {
+				pacing.due = now + pacing.interval;
+			}
+		}
+
+		double MjpegBroadcaster::GetRequiredThroughput(int rendition) {
+			const RenditionLoad& load = loads[rendition];
+			if (load.partBytes == 0 || load.partInterval == 0 || load.lastPart.isElapsed(MAX_PART_GAP)) {
+				return 0;
+			}
+			return load.partBytes * 1000000.0 / load.partInterval;
+		}
+
+		int MjpegBroadcaster::Adapt(Viewer& viewer, int rendition) {
+			if (!viewer.adaptive || !viewer.lastCheck.isElapsed(ADAPT_PERIOD)) {
+				return rendition;
+			}
+
+			// queue overflows since the last check mean the connection fell behind
+			MjpegSession::Stats stats = viewer.session->GetStats();
+			Poco::UInt64 lost = stats.dropped + stats.expired;
+			bool congested = lost > viewer.lastLost;
+			viewer.lastLost = lost;
+			viewer.lastCheck.update();
+
+			double throughput = viewer.session->GetThroughput();
+			double required = GetRequiredThroughput(rendition);
+			int count = static_cast<int>(sessions.size());
+
+			if (rendition + 1 < count && viewer.lastSwitch.isElapsed(DOWN_HOLD) &&
+				(congested || (throughput > 0 && required > 0 && throughput < required * DOWN_MARGIN))) {
+				viewer.lastSwitch.update();
+				return rendition + 1;
+			}
+
+			if (rendition > viewer.ceiling && !congested && throughput > 0 && viewer.lastSwitch.isElapsed(UP_HOLD)) {
+				double larger = GetRequiredThroughput(rendition - 1);
+				if (larger == 0) {
+					larger = required * UNKNOWN_STEP;
+				}
+				if (larger > 0 && throughput > larger * UP_MARGIN) {
+					viewer.lastSwitch.update();
+					return rendition - 1;
+				}
+			}
+			return rendition;
+		}
+
+		void MjpegBroadcaster::Offer(Viewer& viewer, MjpegPart::Ptr part) {
+			if (viewer.adaptive) {
+				// pace by the measured throughput instead of letting the socket back up,
+				// the frames in between are skipped
+				Poco::Timestamp now;
+				if (now < viewer.nextDue) {
+					viewer.session->Skip();
+					return;
+				}
+				double throughput = viewer.session->GetThroughput();
+				if (throughput > 0) {
+					viewer.nextDue = now + static_cast<Poco::Timestamp::TimeDiff>(part->GetSize() * 1000000.0 / throughput);
+				}
+			}
+			viewer.session->Enqueue(part);
+		}
+	}
+}
@@ -0,0 +1,99 @@
+//============================================================================
+// Name        : MjpegPart.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Multipart part of one encoded frame, serialized once and
+//               shared by all viewers
+//============================================================================
+#include "Network/router/MjpegPart.h"
+
+#include "Poco\Net\SocketDefs.h"
+#include "Poco\Net\NetException.h"
+
+#if defined(POCO_OS_FAMILY_UNIX)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#endif
+
+namespace infrastructure {
+	namespace video_streaming {
+		namespace {
+			const char PART_TRAILER[] = "\r\n\r\n";
+			const size_t PART_TRAILER_SIZE = sizeof(PART_TRAILER) - 1;
+
+			string MakeHeader(const EncodedFrame& frame, const string& boundary) {
+				string header = "--" + boundary + "\r\n";
+				header += "Content-Length: " + std::to_string(frame.GetSize()) + "\r\n";
+				header += "Content-Type: image/jpeg\r\n\r\n";
+				return header;
+			}
+		}
+
+		MjpegPart::MjpegPart(EncodedFrame::Ptr frame, const string& boundary, bool prepareSplice)
+			: frame(frame), header(MakeHeader(*frame, boundary)), size(header.size() + frame->GetSize() + PART_TRAILER_SIZE) {
+			if (prepareSplice) {
+				Poco::Net::SocketBuf buffers[3];
+				int count = GetBuffers(0, buffers);
+				pipe = new SplicePipe();
+				if (!pipe->Open(size) || !pipe->Fill(buffers, count, size)) {
+					pipe.reset();
+				}
+			}
+		}
+
+		MjpegPart::~MjpegPart() {
+		}
+
+		int MjpegPart::GetBuffers(size_t offset, Poco::Net::SocketBuf* buffers) const {
+			const char* segments[3] = { header.data(), reinterpret_cast<const char*>(frame->GetData()), PART_TRAILER };
+			const size_t lengths[3] = { header.size(), frame->GetSize(), PART_TRAILER_SIZE };
+
+			int count = 0;
+			for (int i = 0; i < 3; i++) {
+				if (offset >= lengths[i]) {
+					offset -= lengths[i];
+					continue;
+				}
+				buffers[count++] = Poco::Net::Socket::makeBuffer(const_cast<char*>(segments[i] + offset), lengths[i] - offset);
+				offset = 0;
+			}
+			return count;
+		}
+
+		int MjpegPart::Send(StreamSocket& socket, size_t offset) const {
+			Poco::Net::SocketBuf buffers[3];
+			int count = GetBuffers(offset, buffers);
+			if (count == 0) {
+				return 0;
+			}
+
+#if defined(POCO_OS_FAMILY_UNIX)
+			// sendmsg instead of writev so a closed peer is reported as EPIPE instead of raising SIGPIPE
+			struct msghdr message = {};
+			message.msg_iov = buffers;
+			message.msg_iovlen = count;
+#if defined(MSG_NOSIGNAL)
+			const int flags = MSG_NOSIGNAL;
+#else
+			const int flags = 0;
+#endif
+			ssize_t sent;
+			do {
+				sent = ::sendmsg(socket.impl()->sockfd(), &message, flags);
+			} while (sent < 0 && errno == EINTR);
+
+			if (sent < 0) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					return 0;
+				}
+				throw Poco::Net::NetException("sendmsg failed", errno);
+			}
+			return static_cast<int>(sent);
+#else
+			int sent = socket.sendBytes(Poco::Net::SocketBufVec(buffers, buffers + count));
+			return sent > 0 ? sent : 0;
+#endif
+		}
+	}
+}
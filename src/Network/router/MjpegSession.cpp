@@ -0,0 +1,328 @@
+//============================================================================
+// Name        : MjpegSession.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : One MJPEG viewer served by a SocketReactor with a non-blocking socket
+//============================================================================
+#include "Network/router/MjpegSession.h"
+
+#include "Poco\NObserver.h"
+#include "Poco\Exception.h"
+#include "Poco\Logger.h"
+
+#include <algorithm>
+
+using Poco::NObserver;
+
+namespace infrastructure {
+	namespace video_streaming {
+		namespace {
+			const Poco::Timestamp::TimeDiff MIN_THROUGHPUT_SAMPLE = 1000; //in us
+			const double THROUGHPUT_SMOOTHING = 0.25;
+		}
+
+		MjpegSession::MjpegSession(const StreamSocket& socket, SocketReactor& reactor, const Config& config, const Poco::Timestamp& requested)
+			: socket(socket), reactor(reactor), clientAddress(socket.peerAddress()), config(config),
+			closed(false), finished(false), writable(false), primed(0), requested(requested), offset(0), pipeBytes(0), behind(false), throughput(0) {
+			stats.sent = 0;
+			stats.dropped = 0;
+			stats.expired = 0;
+			stats.skipped = 0;
+			stats.evicted = false;
+			stats.bytesWritten = 0;
+			stats.bytesSpliced = 0;
+			stats.firstFrame = 0;
+			this->socket.setBlocking(false);
+			this->socket.setNoDelay(true);
+		}
+
+		MjpegSession::~MjpegSession() {
+		}
+
+		void MjpegSession::Start() {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			reactor.addEventHandler(socket, NObserver<MjpegSession, ReadableNotification>(*this, &MjpegSession::OnReadable));
+			reactor.addEventHandler(socket, NObserver<MjpegSession, ErrorNotification>(*this, &MjpegSession::OnError));
+		}
+
+		void MjpegSession::Enqueue(MjpegPart::Ptr part) {
+			bool evict = false;
+			{
+				Poco::FastMutex::ScopedLock lock(mutex);
+				if (closed) {
+					return;
+				}
+
+				if (current.isNull()) {
+					current = part;
+					offset = 0;
+					partStarted.update();
+					SetWritable(true);
+					return;
+				}
+
+				if (!behind) {
+					behind = true;
+					behindSince.update();
+				}
+
+				if (pending.size() - primed >= static_cast<size_t>(config.queueSize > 0 ? config.queueSize : 1)) {
+					pending.erase(pending.begin() + primed);
+					++stats.dropped;
+				}
+				pending.push_back(part);
+
+				if (config.evictAfter > 0 && behindSince.isElapsed(static_cast<Poco::Timestamp::TimeDiff>(config.evictAfter) * 1000)) {
+					stats.evicted = true;
+					evict = true;
+				}
+			}
+
+			if (evict) {
+				Poco::Logger::get("VideoStreamingRequestHandler").warning("Evicting slow client " + clientAddress.toString());
+				Close();
+			}
+		}
+
+		void MjpegSession::Prime(const vector<MjpegPart::Ptr>& parts) {
+			bool failed = false;
+			{
+				Poco::FastMutex::ScopedLock lock(mutex);
+				if (closed || parts.empty()) {
+					return;
+				}
+
+				vector<MjpegPart::Ptr>::const_iterator next = parts.begin();
+				if (current.isNull()) {
+					current = *next++;
+					offset = 0;
+					partStarted.update();
+				}
+				pending.insert(pending.begin(), next, parts.end());
+				primed += parts.end() - next;
+
+				// the reactor would only pick the socket up with its next poll
+				failed = !WriteParts();
+				if (!failed && !current.isNull()) {
+					SetWritable(true);
+				}
+			}
+
+			if (failed) {
+				Close();
+			}
+		}
+
+		void MjpegSession::NextFrame() {
+			current.reset();
+			offset = 0;
+			while (!pending.empty()) {
+				MjpegPart::Ptr part = pending.front();
+				pending.pop_front();
+				bool wasPrimed = primed > 0;
+				if (wasPrimed) {
+					--primed;
+				}
+				if (!wasPrimed && config.maxFrameAge > 0 && part->GetFrame()->GetTimestamp().isElapsed(static_cast<Poco::Timestamp::TimeDiff>(config.maxFrameAge) * 1000)) {
+					++stats.expired;
+					continue;
+				}
+				current = part;
+				partStarted.update();
+				return;
+			}
+			// caught up with the stream
+			behind = false;
+		}
+
+		void MjpegSession::TeeCurrent() {
+			const SplicePipe* source = current->GetPipe();
+			if (source == nullptr) {
+				return;
+			}
+
+			size_t size = current->GetSize();
+			if (viewerPipe.IsOpen() ? !viewerPipe.Reserve(size) : !viewerPipe.Open(size)) {
+				return;
+			}
+
+			// tee always starts at the beginning of the source, anything it could not
+			// duplicate is sent from offset with sendmsg once the pipe has drained
+			int teed = viewerPipe.TeeFrom(*source, size);
+			if (teed > 0) {
+				offset = teed;
+				pipeBytes = teed;
+			}
+		}
+
+		void MjpegSession::RecordThroughput(size_t bytes, Poco::Timestamp::TimeDiff elapsed) {
+			// parts that fit into the socket buffer right away only say the link keeps up,
+			// the floor keeps them from producing absurd rates
+			double sample = bytes * 1000000.0 / std::max<Poco::Timestamp::TimeDiff>(elapsed, MIN_THROUGHPUT_SAMPLE);
+			throughput = throughput == 0 ? sample : throughput + (sample - throughput) * THROUGHPUT_SMOOTHING;
+		}
+
+		void MjpegSession::SetWritable(bool enable) {
+			if (enable == writable) {
+				return;
+			}
+			NObserver<MjpegSession, WritableNotification> observer(*this, &MjpegSession::OnWritable);
+			if (enable) {
+				reactor.addEventHandler(socket, observer);
+			}
+			else {
+				reactor.removeEventHandler(socket, observer);
+			}
+			writable = enable;
+		}
+
+		void MjpegSession::OnWritable(const Poco::AutoPtr<WritableNotification>& notification) {
+			bool failed = false;
+			{
+				Poco::FastMutex::ScopedLock lock(mutex);
+				failed = !WriteParts();
+			}
+
+			if (failed) {
+				Close();
+			}
+		}
+
+		bool MjpegSession::WriteParts() {
+			try {
+				while (!closed && !current.isNull()) {
+					if (offset == 0 && pipeBytes == 0) {
+						TeeCurrent();
+					}
+
+					if (pipeBytes > 0) {
+						// the kernel moves the teed pages into the socket, nothing is copied here
+						int moved = viewerPipe.SpliceTo(socket, pipeBytes);
+						if (moved <= 0) {
+							break;
+						}
+						pipeBytes -= moved;
+						stats.bytesSpliced += moved;
+					}
+					else {
+						// header, payload and trailer leave in one scatter-gather call, the payload is never copied
+						int sent = current->Send(socket, offset);
+						if (sent <= 0) {
+							// socket buffer is full, wait for the next writable notification
+							break;
+						}
+						offset += sent;
+						stats.bytesWritten += sent;
+					}
+
+					if (offset == current->GetSize() && pipeBytes == 0) {
+						if (++stats.sent == 1) {
+							stats.firstFrame = requested.elapsed();
+						}
+						RecordThroughput(current->GetSize(), partStarted.elapsed());
+						NextFrame();
+						if (current.isNull()) {
+							SetWritable(false);
+						}
+					}
+				}
+			}
+			catch (Poco::TimeoutException&) {
+				// would block on platforms reporting EAGAIN as timeout
+			}
+			catch (Poco::Exception&) {
+				return false;
+			}
+			return true;
+		}
+
+		void MjpegSession::OnReadable(const Poco::AutoPtr<ReadableNotification>& notification) {
+			bool failed = false;
+			{
+				Poco::FastMutex::ScopedLock lock(mutex);
+				if (closed) {
+					return;
+				}
+
+				// viewers never send anything after the request, so readable means closed or garbage
+				char buffer[256];
+				try {
+					failed = socket.receiveBytes(buffer, sizeof(buffer)) <= 0;
+				}
+				catch (Poco::TimeoutException&) {
+				}
+				catch (Poco::Exception&) {
+					failed = true;
+				}
+			}
+
+			if (failed) {
+				Close();
+			}
+		}
+
+		void MjpegSession::OnError(const Poco::AutoPtr<ErrorNotification>& notification) {
+			Close();
+		}
+
+		void MjpegSession::Close() {
+			{
+				Poco::FastMutex::ScopedLock lock(mutex);
+				if (closed) {
+					return;
+				}
+				closed = true;
+				current.reset();
+				pending.clear();
+				primed = 0;
+				viewerPipe.Close();
+				pipeBytes = 0;
+			}
+
+			// outside of the session mutex: removing an observer waits for a callback
+			// running on the reactor thread, which may itself wait for the mutex
+			reactor.removeEventHandler(socket, NObserver<MjpegSession, WritableNotification>(*this, &MjpegSession::OnWritable));
+			reactor.removeEventHandler(socket, NObserver<MjpegSession, ReadableNotification>(*this, &MjpegSession::OnReadable));
+			reactor.removeEventHandler(socket, NObserver<MjpegSession, ErrorNotification>(*this, &MjpegSession::OnError));
+
+			try {
+				socket.shutdown();
+			}
+			catch (Poco::Exception&) {
+			}
+			socket.close();
+
+			Stats summary = GetStats();
+			Poco::Logger::get("VideoStreamingRequestHandler").information("Video streaming stopped for client " + clientAddress.toString() +
+				": " + std::to_string(summary.sent) + " frames sent, " + std::to_string(summary.dropped) + " dropped, " +
+				std::to_string(summary.expired) + " expired, " + std::to_string(summary.skipped) + " skipped, " +
+				std::to_string(summary.bytesWritten) + " bytes written, " +
+				std::to_string(summary.bytesSpliced) + " bytes spliced" + (summary.evicted ? ", evicted" : ""));
+
+			finished = true;
+		}
+
+		bool MjpegSession::IsClosed() {
+			return finished;
+		}
+
+		void MjpegSession::Skip() {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			++stats.skipped;
+		}
+
+		double MjpegSession::GetThroughput() {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			return throughput;
+		}
+
+		const SocketAddress& MjpegSession::GetClientAddress() const {
+			return clientAddress;
+		}
+
+		MjpegSession::Stats MjpegSession::GetStats() {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			return stats;
+		}
+	}
+}
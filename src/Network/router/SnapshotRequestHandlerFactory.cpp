@@ -0,0 +1,118 @@
+//============================================================================
+// Name        : SnapshotRequestHandlerFactory.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Latest encoded frame as a still image under /api/webcam/snapshot.jpg
+//============================================================================
+#include "Network/router/SnapshotRequestHandlerFactory.h"
+
+#include "Poco\URI.h"
+#include "Poco\NumberFormatter.h"
+#include "Poco\StringTokenizer.h"
+#include "Poco\Timestamp.h"
+#include "Poco\Net\HTTPRequest.h"
+
+using Poco::Net::HTTPResponse;
+using Poco::Net::HTTPRequest;
+using services::webcam::EncodedFrame;
+
+namespace infrastructure {
+	namespace video_streaming {
+		SnapshotRequestHandlerFactory::SnapshotRequestHandlerFactory(SharedPtr<WebcamService> webcamService, const Config& config)
+			: webcamService(webcamService), config(config), instance(Poco::NumberFormatter::formatHex(Poco::Timestamp().epochMicroseconds())) { }
+
+		SnapshotRequestHandlerFactory::~SnapshotRequestHandlerFactory() {
+			//do not delete, since it is a shared pointer
+			webcamService = nullptr;
+		}
+
+		HTTPRequestHandler* SnapshotRequestHandlerFactory::createRequestHandler(const HTTPServerRequest& request) {
+			return new SnapshotRequestHandler(webcamService, config, instance);
+		}
+
+		SnapshotRequestHandler::SnapshotRequestHandler(SharedPtr<WebcamService> webcamService, const SnapshotRequestHandlerFactory::Config& config,
+			const string& instance) : webcamService(webcamService), config(config), instance(instance) { }
+
+		SnapshotRequestHandler::~SnapshotRequestHandler() {
+			//do not delete, since it is a shared pointer
+			webcamService = nullptr;
+		}
+
+		bool SnapshotRequestHandler::IsMatch(const HTTPServerRequest& request, const string& etag) {
+			if (!request.has("If-None-Match")) {
+				return false;
+			}
+			Poco::StringTokenizer tags(request.get("If-None-Match"), ",", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+			for (auto& tag : tags) {
+				// weak comparison as RFC 7232 asks for with If-None-Match
+				if (tag == "*" || tag == etag || tag == "W/" + etag) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void SnapshotRequestHandler::handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+			// clients may keep the image but have to ask whether it is still the latest
+			response.set("Cache-Control", "no-cache");
+
+			if (!webcamService->IsRecording()) {
+				response.setStatus(HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
+				response.send();
+				return;
+			}
+
+			// ?rendition=<name> as for the stream, the first rendition by default
+			int rendition = 0;
+			Poco::URI::QueryParameters parameters = Poco::URI(request.getURI()).getQueryParameters();
+			for (auto& parameter : parameters) {
+				if (parameter.first == "rendition") {
+					rendition = webcamService->FindRendition(parameter.second);
+					if (rendition < 0) {
+						response.setStatusAndReason(HTTPResponse::HTTP_NOT_FOUND);
+						response.setContentType("text/plain");
+						response.send() << "Unknown rendition " << parameter.second;
+						return;
+					}
+				}
+			}
+
+			// snapshots do not register as viewers, the hold keeps the rendition encoded for the next one
+			webcamService->HoldViewer(rendition, config.maxWait + config.hold);
+
+			EncodedFrame::Ptr frame = webcamService->GetModifiedImage(rendition);
+			if (!frame || frame->GetTimestamp().isElapsed(static_cast<Poco::Timestamp::TimeDiff>(config.maxAge) * 1000)) {
+				// encoding was suspended without viewers, wait for a fresh frame
+				EncodedFrame::Ptr next = webcamService->GetModifiedImage(rendition, frame ? frame->GetSequence() : 0, config.maxWait);
+				if (next) {
+					frame = next;
+				}
+			}
+			if (!frame) {
+				response.setStatus(HTTPResponse::HTTP_SERVICE_UNAVAILABLE);
+				response.set("Retry-After", "1");
+				response.send();
+				return;
+			}
+
+			const string etag = "\"" + instance + "-" + std::to_string(rendition) + "-" + Poco::NumberFormatter::format(frame->GetSequence()) + "\"";
+			response.set("ETag", etag);
+			if (IsMatch(request, etag)) {
+				response.setStatus(HTTPResponse::HTTP_NOT_MODIFIED);
+				response.send();
+				return;
+			}
+
+			response.set("X-Frame-Sequence", Poco::NumberFormatter::format(frame->GetSequence()));
+			response.set("X-Frame-Timestamp", Poco::NumberFormatter::format(frame->GetTimestamp().epochMicroseconds()));
+			response.setContentType("image/jpeg");
+			response.setContentLength(static_cast<std::streamsize>(frame->GetSize()));
+			if (request.getMethod() == HTTPRequest::HTTP_HEAD) {
+				response.send();
+				return;
+			}
+			// every concurrent request sends from the same immutable frame, nothing is copied per client
+			response.sendBuffer(frame->GetData(), frame->GetSize());
+		}
+	}
+}
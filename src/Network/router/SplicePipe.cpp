@@ -0,0 +1,145 @@
+//============================================================================
+// Name        : SplicePipe.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Linux pipe used to move multipart parts into sockets with
+//               tee()/splice() instead of copying them through user space
+//============================================================================
+#include "Network/router/SplicePipe.h"
+
+#include "Poco\Net\NetException.h"
+
+#if defined(POCO_OS_FAMILY_UNIX) && defined(__linux__)
+#define SPLICE_SUPPORTED 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#endif
+
+namespace infrastructure {
+	namespace video_streaming {
+		SplicePipe::SplicePipe() : readFd(-1), writeFd(-1), capacity(0) {
+		}
+
+		SplicePipe::~SplicePipe() {
+			Close();
+		}
+
+		bool SplicePipe::IsSupported() {
+#if defined(SPLICE_SUPPORTED)
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		bool SplicePipe::Open(size_t capacity) {
+			Close();
+#if defined(SPLICE_SUPPORTED)
+			int fds[2];
+			if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0) {
+				return false;
+			}
+			readFd = fds[0];
+			writeFd = fds[1];
+			this->capacity = static_cast<size_t>(::fcntl(writeFd, F_GETPIPE_SZ));
+			if (!Reserve(capacity)) {
+				Close();
+				return false;
+			}
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		bool SplicePipe::Reserve(size_t capacity) {
+#if defined(SPLICE_SUPPORTED)
+			if (writeFd < 0) {
+				return false;
+			}
+			if (this->capacity >= capacity) {
+				return true;
+			}
+			int size = ::fcntl(writeFd, F_SETPIPE_SZ, static_cast<int>(capacity));
+			if (size < 0) {
+				return false;
+			}
+			this->capacity = static_cast<size_t>(size);
+			return this->capacity >= capacity;
+#else
+			return false;
+#endif
+		}
+
+		void SplicePipe::Close() {
+#if defined(SPLICE_SUPPORTED)
+			if (readFd >= 0) {
+				::close(readFd);
+			}
+			if (writeFd >= 0) {
+				::close(writeFd);
+			}
+#endif
+			readFd = -1;
+			writeFd = -1;
+			capacity = 0;
+		}
+
+		bool SplicePipe::IsOpen() const {
+			return writeFd >= 0;
+		}
+
+		size_t SplicePipe::GetCapacity() const {
+			return capacity;
+		}
+
+		bool SplicePipe::Fill(const Poco::Net::SocketBuf* buffers, int count, size_t size) {
+#if defined(SPLICE_SUPPORTED)
+			if (writeFd < 0 || size > capacity) {
+				return false;
+			}
+			// plain writev on purpose: vmsplice would let sockets reference frame memory after it was freed
+			ssize_t written;
+			do {
+				written = ::writev(writeFd, buffers, count);
+			} while (written < 0 && errno == EINTR);
+			return written == static_cast<ssize_t>(size);
+#else
+			return false;
+#endif
+		}
+
+		int SplicePipe::TeeFrom(const SplicePipe& source, size_t length) {
+#if defined(SPLICE_SUPPORTED)
+			ssize_t teed;
+			do {
+				teed = ::tee(source.readFd, writeFd, length, SPLICE_F_NONBLOCK);
+			} while (teed < 0 && errno == EINTR);
+			return teed > 0 ? static_cast<int>(teed) : 0;
+#else
+			return 0;
+#endif
+		}
+
+		int SplicePipe::SpliceTo(StreamSocket& socket, size_t length) {
+#if defined(SPLICE_SUPPORTED)
+			ssize_t moved;
+			do {
+				moved = ::splice(readFd, nullptr, socket.impl()->sockfd(), nullptr, length, SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+			} while (moved < 0 && errno == EINTR);
+
+			if (moved < 0) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					return 0;
+				}
+				throw Poco::Net::NetException("splice failed", errno);
+			}
+			return static_cast<int>(moved);
+#else
+			throw Poco::Net::NetException("splice is not supported on this platform");
+#endif
+		}
+	}
+}
@@ -6,40 +6,46 @@
 //============================================================================
 #include "Network/router/VideoStreamingRequestHandlerFactory.h"
 
-#include "Poco\Net\MultipartWriter.h"
-#include "Poco\Net\MessageHeader.h"
+#include "Poco\Net\HTTPServerRequestImpl.h"
+#include "Poco\URI.h"
+#include "Poco\String.h"
+#include "Poco\NumberParser.h"
+#include "Poco\NumberFormatter.h"
 
-using Poco::Net::MessageHeader;
 using Poco::Net::HTTPResponse;
-using Poco::Net::MultipartWriter;
+using Poco::Net::HTTPServerRequestImpl;
 
 namespace infrastructure {
 	namespace video_streaming {
-		VideoStreamingRequestHandlerFactory::VideoStreamingRequestHandlerFactory(SharedPtr<WebcamService> webcamService
-        ) : webcamService(webcamService) { }
+		VideoStreamingRequestHandlerFactory::VideoStreamingRequestHandlerFactory(SharedPtr<WebcamService> webcamService,
+			SharedPtr<MjpegBroadcaster> broadcaster
+        ) : webcamService(webcamService), broadcaster(broadcaster) { }
 
 		VideoStreamingRequestHandlerFactory::~VideoStreamingRequestHandlerFactory() {
 			//do not delete, since it is a shared pointer
 			webcamService = nullptr;
+			broadcaster = nullptr;
 		}
 
 		HTTPRequestHandler* VideoStreamingRequestHandlerFactory::createRequestHandler(const HTTPServerRequest& request) {
 
-			return new VideoStreamingRequestHandler(webcamService);
+			return new VideoStreamingRequestHandler(webcamService, broadcaster);
 
 		}
 
-        		VideoStreamingRequestHandler::VideoStreamingRequestHandler(SharedPtr<WebcamService> webcamService)
-			: webcamService(webcamService){
-			boundary = "VIDEOSTREAM";
+        		VideoStreamingRequestHandler::VideoStreamingRequestHandler(SharedPtr<WebcamService> webcamService, SharedPtr<MjpegBroadcaster> broadcaster)
+			: webcamService(webcamService), broadcaster(broadcaster) {
+			boundary = broadcaster->GetBoundary();
 		}
 
 		VideoStreamingRequestHandler::~VideoStreamingRequestHandler() {
 			//do not delete, since it is a shared pointer
 			webcamService = nullptr;
+			broadcaster = nullptr;
 		}
 
 		void VideoStreamingRequestHandler::handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+			Poco::Timestamp requested;
 			Poco::Logger& logger = Poco::Logger::get("VideoStreamingRequestHandler");
 			logger.information("Video stream request by client: " + request.clientAddress().toString());
 
@@ -51,7 +57,40 @@ namespace infrastructure {
 				return;
 			}
 
-			logger.information("Video streaming started for client " + request.clientAddress().toString());
+			// ?rendition=<name> picks an output of the encoding ladder, the first one is the default
+			// ?adaptive=0 pins the viewer to it instead of following its throughput down the ladder
+			// ?fps=<n> caps the frames per second sent to the viewer
+			int rendition = 0;
+			bool adaptive = broadcaster->IsAdaptive();
+			double fps = 0;
+			Poco::URI::QueryParameters parameters = Poco::URI(request.getURI()).getQueryParameters();
+			for (auto& parameter : parameters) {
+				if (parameter.first == "adaptive") {
+					adaptive = parameter.second != "0" && Poco::icompare(parameter.second, "false") != 0;
+				}
+				if (parameter.first == "rendition") {
+					rendition = webcamService->FindRendition(parameter.second);
+					if (rendition < 0) {
+						logger.warning("Unknown rendition \"" + parameter.second + "\" requested by " + request.clientAddress().toString());
+						response.setStatusAndReason(HTTPResponse::HTTP_NOT_FOUND);
+						response.setContentType("text/plain");
+						response.send() << "Unknown rendition " << parameter.second;
+						return;
+					}
+				}
+				if (parameter.first == "fps") {
+					if (!Poco::NumberParser::tryParseFloat(parameter.second, fps) || fps <= 0) {
+						response.setStatusAndReason(HTTPResponse::HTTP_BAD_REQUEST);
+						response.setContentType("text/plain");
+						response.send() << "Invalid frame rate " << parameter.second;
+						return;
+					}
+				}
+			}
+
+			logger.information("Video streaming started for client " + request.clientAddress().toString() +
+				" with rendition " + webcamService->GetRenditions()[rendition].name + (adaptive ? ", adaptive" : "") +
+				(fps > 0 ? ", at most " + Poco::NumberFormatter::format(fps, 2) + " fps" : ""));
 
 			response.set("Max-Age", "0");
 			response.set("Expires", "0");
@@ -61,42 +100,12 @@ namespace infrastructure {
 			response.setChunkedTransferEncoding(false);
 
 			std::ostream& out = response.send();
-			int frames = 0;
-			//double start = 0.0;
-			//double dif = 0.0;
-
-			while (out.good() && webcamService->IsRecording()) {
-				//start = CLOCK();
-
-				MultipartWriter writer(out, boundary);
-
-				vector<uchar>* buf = webcamService->GetModifiedImage(); //take ownership
-
-				if (buf->size() == 0) {
-					logger.warning("Read empty stream image");
-					delete buf;
-					continue;
-				}
-
-				MessageHeader header = MessageHeader();
-				header.set("Content-Length", std::to_string(buf->size()));
-				header.set("Content-Type", "image/jpeg");
-				writer.nextPart(header);
-				out.write(reinterpret_cast<const char*>(buf->data()), buf->size());
-				out << "\r\n\r\n";
-
-				delete buf;
-				buf = nullptr;
-
-				//dif = CLOCK() - start;
-				//printf("Sending: %.2f ms; avg: %.2f ms\r", dif, avgdur(dif));
-				++frames;
-			}
-
-			printf("Frames: %u", frames);
+			out.flush();
 
-			logger.information("Video streaming stopped for client " + request.clientAddress().toString());
-			//server.HandleClientLostConnection(request.clientAddress());
+			// the reactor threads of the broadcaster serve the connection from here on,
+			// this pool thread is released as soon as the headers are written
+			StreamSocket socket = static_cast<HTTPServerRequestImpl&>(request).detachSocket();
+			broadcaster->AddClient(socket, rendition, adaptive, fps, requested);
 		}
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,215 @@
+//============================================================================
+// Name        : WebSocketStreamRequestHandlerFactory.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Encoded frames as binary WebSocket messages under /api/webcam/ws,
+//               paced by acknowledgements of the client
+//============================================================================
+#include "Network/router/WebSocketStreamRequestHandlerFactory.h"
+
+#include "Poco\Net\NetException.h"
+#include "Poco\URI.h"
+#include "Poco\NumberParser.h"
+#include "Poco\Logger.h"
+
+#include <algorithm>
+#include <deque>
+
+using Poco::Net::HTTPResponse;
+using Poco::Net::Socket;
+using services::webcam::EncodedFrame;
+
+namespace infrastructure {
+	namespace video_streaming {
+		namespace {
+			const long FRAME_WAIT_TIMEOUT = 100; //in ms, bounds how long acknowledgements and close frames wait to be read
+			const int MAX_ACK_SIZE = 64; //in bytes, larger client messages end the connection
+
+			void WriteUInt64(unsigned char* buffer, Poco::UInt64 value) {
+				for (int i = 7; i >= 0; i--) {
+					buffer[i] = static_cast<unsigned char>(value & 0xFF);
+					value >>= 8;
+				}
+			}
+
+			Poco::UInt64 ReadUInt64(const unsigned char* buffer) {
+				Poco::UInt64 value = 0;
+				for (int i = 0; i < 8; i++) {
+					value = (value << 8) | buffer[i];
+				}
+				return value;
+			}
+		}
+
+		WebSocketStreamRequestHandlerFactory::WebSocketStreamRequestHandlerFactory(SharedPtr<WebcamService> webcamService, const Config& config)
+			: webcamService(webcamService), config(config), clients(0) { }
+
+		WebSocketStreamRequestHandlerFactory::~WebSocketStreamRequestHandlerFactory() {
+			//do not delete, since it is a shared pointer
+			webcamService = nullptr;
+		}
+
+		HTTPRequestHandler* WebSocketStreamRequestHandlerFactory::createRequestHandler(const HTTPServerRequest& request) {
+			return new WebSocketStreamRequestHandler(webcamService, config, clients);
+		}
+
+		WebSocketStreamRequestHandler::WebSocketStreamRequestHandler(SharedPtr<WebcamService> webcamService,
+			const WebSocketStreamRequestHandlerFactory::Config& config, std::atomic<int>& clients)
+			: webcamService(webcamService), config(config), clients(clients) { }
+
+		WebSocketStreamRequestHandler::~WebSocketStreamRequestHandler() {
+			//do not delete, since it is a shared pointer
+			webcamService = nullptr;
+		}
+
+		void WebSocketStreamRequestHandler::handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+			Poco::Logger& logger = Poco::Logger::get("VideoStreamingRequestHandler");
+			response.set("Cache-Control", "no-cache, private");
+
+			if (!webcamService->IsRecording()) {
+				response.setStatus(HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
+				response.send();
+				return;
+			}
+
+			// ?rendition=<name> as for /api/webcam, ?window=<n> unacknowledged frames up to maxWindow
+			int rendition = 0;
+			int window = config.window;
+			Poco::URI::QueryParameters parameters = Poco::URI(request.getURI()).getQueryParameters();
+			for (auto& parameter : parameters) {
+				bool valid = true;
+				if (parameter.first == "rendition") {
+					rendition = webcamService->FindRendition(parameter.second);
+					valid = rendition >= 0;
+				}
+				else if (parameter.first == "window") {
+					valid = Poco::NumberParser::tryParse(parameter.second, window) && window > 0;
+				}
+				if (!valid) {
+					response.setStatusAndReason(HTTPResponse::HTTP_BAD_REQUEST);
+					response.setContentType("text/plain");
+					response.send() << "Invalid " << parameter.first << " " << parameter.second;
+					return;
+				}
+			}
+			window = std::max(1, std::min(window, config.maxWindow));
+
+			if (++clients > config.maxClients) {
+				--clients;
+				logger.warning("Too many WebSocket clients, rejecting " + request.clientAddress().toString());
+				response.setStatusAndReason(HTTPResponse::HTTP_SERVICE_UNAVAILABLE);
+				response.set("Retry-After", "10");
+				response.send();
+				return;
+			}
+
+			Stats stats;
+			webcamService->AddViewer(rendition);
+			try {
+				// answers the handshake, or throws if this is no WebSocket upgrade
+				WebSocket socket(request, response);
+				socket.setNoDelay(true);
+				logger.information("WebSocket stream started for client " + request.clientAddress().toString() + " with rendition " +
+					webcamService->GetRenditions()[rendition].name + ", window " + std::to_string(window));
+				Stream(socket, rendition, static_cast<size_t>(window), stats);
+			}
+			catch (Poco::Net::WebSocketException& e) {
+				logger.warning("WebSocket stream for " + request.clientAddress().toString() + " failed: " + e.displayText());
+				if (!response.sent()) {
+					response.setStatusAndReason(HTTPResponse::HTTP_BAD_REQUEST);
+					response.setContentLength(0);
+					response.send();
+				}
+			}
+			catch (Poco::Exception& e) {
+				// connection reset or timed out, the viewer is simply gone
+				logger.information("WebSocket stream for " + request.clientAddress().toString() + " ended: " + e.displayText());
+			}
+			webcamService->RemoveViewer(rendition);
+			--clients;
+
+			logger.information("WebSocket client " + request.clientAddress().toString() + " disconnected after " + std::to_string(stats.frames) +
+				" frames, " + std::to_string(stats.bytes / 1024) + " KiB, " + std::to_string(stats.skipped) + " skipped, " +
+				std::to_string(stats.acks > 0 ? stats.roundTrip / static_cast<Poco::Timestamp::TimeDiff>(stats.acks) / 1000 : 0) + " ms average round trip");
+		}
+
+		void WebSocketStreamRequestHandler::Stream(WebSocket& socket, int rendition, size_t window, Stats& stats) {
+			// sequence and send time of the unacknowledged frames, oldest first
+			std::deque<std::pair<Poco::UInt64, Poco::Timestamp>> inFlight;
+			Poco::UInt64 lastSent = 0;
+			Poco::Timestamp lastAck;
+			unsigned char header[HEADER_SIZE] = { VERSION, static_cast<unsigned char>(rendition), 0, HEADER_SIZE };
+			unsigned char message[MAX_ACK_SIZE];
+
+			while (webcamService->IsRecording()) {
+				if (inFlight.size() < window) {
+					// always the latest frame, whatever was encoded while the window was full is skipped
+					EncodedFrame::Ptr frame = webcamService->GetModifiedImage(rendition, lastSent, FRAME_WAIT_TIMEOUT);
+					if (!frame.isNull() && frame->GetSequence() > lastSent) {
+						WriteUInt64(header + 4, frame->GetSequence());
+						WriteUInt64(header + 12, static_cast<Poco::UInt64>(frame->GetTimestamp().epochMicroseconds()));
+						// header and JPEG as two fragments of one message, the JPEG is not copied per client
+						socket.sendFrame(header, HEADER_SIZE, WebSocket::FRAME_OP_BINARY);
+						socket.sendFrame(frame->GetData(), static_cast<int>(frame->GetSize()), WebSocket::FRAME_FLAG_FIN | WebSocket::FRAME_OP_CONT);
+
+						if (lastSent > 0) {
+							stats.skipped += frame->GetSequence() - lastSent - 1;
+						}
+						if (inFlight.empty()) {
+							lastAck.update();
+						}
+						lastSent = frame->GetSequence();
+						inFlight.push_back(std::make_pair(lastSent, Poco::Timestamp()));
+						++stats.frames;
+						stats.bytes += frame->GetSize();
+					}
+				}
+
+				// with a full window nothing else is to be done than waiting for the client
+				Poco::Timespan wait(inFlight.size() >= window ? FRAME_WAIT_TIMEOUT * 1000 : 0);
+				while (socket.poll(wait, Socket::SELECT_READ)) {
+					wait = 0;
+					int flags = 0;
+					int length = socket.receiveFrame(message, sizeof(message), flags);
+					int opcode = flags & WebSocket::FRAME_OP_BITMASK;
+					if ((length == 0 && flags == 0) || opcode == WebSocket::FRAME_OP_CLOSE) {
+						socket.shutdown();
+						return;
+					}
+					if (opcode == WebSocket::FRAME_OP_PING) {
+						socket.sendFrame(message, length, WebSocket::FRAME_FLAG_FIN | WebSocket::FRAME_OP_PONG);
+						continue;
+					}
+
+					Poco::UInt64 acked = 0;
+					bool valid = opcode == WebSocket::FRAME_OP_BINARY ? length == 8 :
+						opcode == WebSocket::FRAME_OP_TEXT && Poco::NumberParser::tryParseUnsigned64(string(reinterpret_cast<char*>(message), length), acked);
+					if (opcode == WebSocket::FRAME_OP_BINARY && valid) {
+						acked = ReadUInt64(message);
+					}
+					if (!valid) {
+						socket.shutdown(WebSocket::WS_PAYLOAD_NOT_ACCEPTABLE, "expected the sequence of a received frame");
+						return;
+					}
+
+					// acknowledgements are cumulative, a lost one is made up for by the next
+					Poco::Timestamp now;
+					while (!inFlight.empty() && inFlight.front().first <= acked) {
+						if (inFlight.front().first == acked) {
+							stats.roundTrip += now - inFlight.front().second;
+							++stats.acks;
+						}
+						inFlight.pop_front();
+					}
+					lastAck = now;
+				}
+
+				if (inFlight.size() >= window && config.ackTimeout > 0 && lastAck.isElapsed(static_cast<Poco::Timestamp::TimeDiff>(config.ackTimeout) * 1000)) {
+					socket.shutdown(WebSocket::WS_POLICY_VIOLATION, "frames were not acknowledged");
+					return;
+				}
+			}
+			socket.shutdown(WebSocket::WS_ENDPOINT_GOING_AWAY);
+		}
+	}
+}
@@ -0,0 +1,130 @@
+//============================================================================
+// Name        : WebcamStatusRequestHandlerFactory.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : JSON report of the pipeline state under /api/webcam/status
+//============================================================================
+#include "Network/router/WebcamStatusRequestHandlerFactory.h"
+
+#include "Poco\JSON\Object.h"
+#include "Poco\JSON\Array.h"
+
+using Poco::JSON::Object;
+using Poco::JSON::Array;
+using services::webcam::StageStats;
+using services::webcam::EncodingGovernor;
+using services::webcam::Rendition;
+using services::webcam::BufferPool;
+using services::webcam::ProcessingGraph;
+
+namespace infrastructure {
+	namespace video_streaming {
+		namespace {
+			Object::Ptr ToJSON(StageStats& stats) {
+				StageStats::Snapshot snapshot = stats.GetSnapshot();
+				Object::Ptr result = new Object();
+				result->set("frames", snapshot.frames);
+				result->set("dropped", snapshot.dropped);
+				result->set("averageMs", snapshot.averageMs);
+				result->set("maxMs", snapshot.maxMs);
+				return result;
+			}
+		}
+
+		WebcamStatusRequestHandlerFactory::WebcamStatusRequestHandlerFactory(SharedPtr<WebcamService> webcamService,
+			SharedPtr<MjpegBroadcaster> broadcaster) : webcamService(webcamService), broadcaster(broadcaster) { }
+
+		WebcamStatusRequestHandlerFactory::~WebcamStatusRequestHandlerFactory() {
+			//do not delete, since it is a shared pointer
+			webcamService = nullptr;
+			broadcaster = nullptr;
+		}
+
+		HTTPRequestHandler* WebcamStatusRequestHandlerFactory::createRequestHandler(const HTTPServerRequest& request) {
+			return new WebcamStatusRequestHandler(webcamService, broadcaster);
+		}
+
+		WebcamStatusRequestHandler::WebcamStatusRequestHandler(SharedPtr<WebcamService> webcamService, SharedPtr<MjpegBroadcaster> broadcaster)
+			: webcamService(webcamService), broadcaster(broadcaster) { }
+
+		WebcamStatusRequestHandler::~WebcamStatusRequestHandler() {
+			//do not delete, since it is a shared pointer
+			webcamService = nullptr;
+			broadcaster = nullptr;
+		}
+
+		void WebcamStatusRequestHandler::handleRequest(HTTPServerRequest& request, HTTPServerResponse& response) {
+			EncodingGovernor& governor = webcamService->GetGovernor();
+			EncodingGovernor::State state = governor.GetState();
+
+			Object::Ptr status = new Object();
+			status->set("recording", webcamService->IsRecording());
+			status->set("suspended", webcamService->IsSuspended());
+			status->set("passthrough", webcamService->IsPassthrough());
+			status->set("nativeYUV", webcamService->IsNativeYUV());
+			status->set("viewers", webcamService->GetViewerCount());
+			status->set("clients", static_cast<Poco::UInt64>(broadcaster->GetClientCount()));
+			status->set("paced", static_cast<Poco::UInt64>(broadcaster->GetPacedClientCount()));
+
+			Object::Ptr governorStatus = new Object();
+			governorStatus->set("enabled", state.enabled);
+			governorStatus->set("fps", state.fps);
+			governorStatus->set("sourceFps", state.sourceFps);
+			governorStatus->set("qualityDrop", state.qualityDrop);
+			governorStatus->set("load", state.load);
+			governorStatus->set("encodeLoad", state.encodeLoad);
+			governorStatus->set("captureLoad", state.captureLoad);
+			governorStatus->set("cpuPercent", state.cpuPercent);
+			governorStatus->set("adjustments", state.adjustments);
+			status->set("governor", governorStatus);
+
+			Array::Ptr renditions = new Array();
+			const vector<Rendition>& ladder = webcamService->GetRenditions();
+			for (size_t i = 0; i < ladder.size(); i++) {
+				Object::Ptr rendition = new Object();
+				rendition->set("name", ladder[i].name);
+				rendition->set("width", ladder[i].width);
+				rendition->set("height", ladder[i].height);
+				rendition->set("fps", ladder[i].fps);
+				rendition->set("quality", governor.GetQuality(ladder[i].quality));
+				rendition->set("viewers", webcamService->GetViewerCount(static_cast<int>(i)));
+				renditions->add(rendition);
+			}
+			status->set("renditions", renditions);
+
+			status->set("capture", ToJSON(webcamService->GetCaptureStats()));
+			status->set("encode", ToJSON(webcamService->GetEncodeStats()));
+			status->set("latency", ToJSON(webcamService->GetLatencyStats()));
+			status->set("firstFrame", ToJSON(broadcaster->GetFirstFrameStats()));
+
+			BufferPool::Stats poolStats = webcamService->GetBufferPool().GetStats();
+			Object::Ptr pool = new Object();
+			pool->set("hits", poolStats.hits);
+			pool->set("misses", poolStats.misses);
+			pool->set("freed", poolStats.freed);
+			pool->set("idleBytes", poolStats.idleBytes);
+			pool->set("usedBytes", poolStats.usedBytes);
+			status->set("pool", pool);
+
+			Array::Ptr stages = new Array();
+			vector<ProcessingGraph::StageStatus> graph = webcamService->GetProcessingGraph().GetStatus();
+			for (auto& stageStatus : graph) {
+				Object::Ptr stage = new Object();
+				stage->set("name", stageStatus.name);
+				stage->set("upstream", stageStatus.upstream);
+				stage->set("queued", static_cast<Poco::UInt64>(stageStatus.queued));
+				stage->set("frames", stageStatus.process.frames);
+				stage->set("dropped", stageStatus.process.dropped);
+				stage->set("averageMs", stageStatus.process.averageMs);
+				stage->set("maxMs", stageStatus.process.maxMs);
+				stage->set("latencyMs", stageStatus.latency.averageMs);
+				stages->add(stage);
+			}
+			status->set("stages", stages);
+
+			response.set("Cache-Control", "no-cache, private");
+			response.setContentType("application/json");
+			status->stringify(response.send());
+		}
+	}
+}
@@ -13,6 +13,7 @@
 #include "LiveSubSystem.h"
 
 #include <cstring>
+#include <csignal>
 #include <iostream>
 
 
@@ -35,6 +36,10 @@ public:
 		_errorHandler(*this),
 		_subSystem(new LiveStream::LiveSubSystem)		
 	{
+#if defined(POCO_OS_FAMILY_UNIX)
+		// splice() into a socket whose peer is gone raises SIGPIPE, there is no per call flag to suppress it
+		std::signal(SIGPIPE, SIG_IGN);
+#endif
 		Poco::DataURIStreamFactory::registerFactory();
 		Poco::ErrorHandler::set(&_errorHandler);
 		addSubsystem(_subSystem);
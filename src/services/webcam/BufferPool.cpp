@@ -0,0 +1,259 @@
+//============================================================================
+// Name        : BufferPool.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Size classed pool recycling frame memory and JPEG buffers
+//============================================================================
+#include "services/webcam/BufferPool.h"
+
+#include "opencv2\core\core_c.h"
+#include "Poco\NumberFormatter.h"
+
+#if defined(POCO_OS_FAMILY_UNIX)
+#include <sys/mman.h>
+#endif
+
+namespace services {
+	namespace webcam {
+		namespace {
+			const int MIN_SHIFT = 8;             //smallest class is 256 bytes
+			const int CLASSES_PER_DOUBLING = 4;  //classes are a quarter power of two apart, at most 25 % is wasted
+			const int CLASS_COUNT = CLASSES_PER_DOUBLING * (48 - MIN_SHIFT);
+			const int MAX_CLASS_SKIP = 4;        //idle vectors up to twice as large as requested are handed out
+			const size_t HEADER_SIZE = 64;       //cache line, the block behind the header keeps the alignment
+			const size_t HUGE_PAGE = 2 * 1024 * 1024;
+		}
+
+		BufferPool::MatAllocator::MatAllocator(BufferPool& pool) : pool(pool) {
+		}
+
+		cv::UMatData* BufferPool::MatAllocator::allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+			cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const {
+			// like cv::StdMatAllocator, only the memory comes from the pool
+			size_t total = CV_ELEM_SIZE(type);
+			for (int i = dims - 1; i >= 0; i--) {
+				if (step) {
+					if (data && step[i] != CV_AUTOSTEP) {
+						total = step[i];
+					}
+					else {
+						step[i] = total;
+					}
+				}
+				total *= sizes[i];
+			}
+
+			cv::UMatData* u = new cv::UMatData(this);
+			u->data = u->origdata = data ? static_cast<uchar*>(data) : static_cast<uchar*>(pool.Allocate(total));
+			u->size = total;
+			if (data) {
+				u->flags |= cv::UMatData::USER_ALLOCATED;
+			}
+			return u;
+		}
+
+		bool BufferPool::MatAllocator::allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const {
+			return data != nullptr;
+		}
+
+		void BufferPool::MatAllocator::deallocate(cv::UMatData* u) const {
+			if (!u) {
+				return;
+			}
+			CV_Assert(u->urefcount == 0);
+			CV_Assert(u->refcount == 0);
+			void* block = (u->flags & cv::UMatData::USER_ALLOCATED) ? nullptr : u->origdata;
+			delete u;
+			if (block) {
+				// may drop the last reference to the pool and with it this allocator
+				pool.Release(block);
+			}
+		}
+
+		BufferPool::BufferPool(const Config& config) : config(config), matAllocator(*this),
+			idleBlocks(CLASS_COUNT), idleBuffers(CLASS_COUNT) {
+			stats.hits = 0;
+			stats.misses = 0;
+			stats.freed = 0;
+			stats.idleBytes = 0;
+			stats.usedBytes = 0;
+		}
+
+		BufferPool::~BufferPool() {
+			for (auto& blocks : idleBlocks) {
+				for (BlockHeader* header : blocks) {
+					FreeBlock(header);
+				}
+			}
+		}
+
+		size_t BufferPool::GetClassSize(int sizeClass) {
+			int shift = sizeClass / CLASSES_PER_DOUBLING + MIN_SHIFT;
+			int quarter = sizeClass % CLASSES_PER_DOUBLING;
+			return (static_cast<size_t>(CLASSES_PER_DOUBLING + quarter) << shift) / CLASSES_PER_DOUBLING;
+		}
+
+		int BufferPool::GetClass(size_t size) {
+			if (size <= GetClassSize(0)) {
+				return 0;
+			}
+			int shift = MIN_SHIFT;
+			while ((static_cast<size_t>(1) << (shift + 1)) <= size) {
+				++shift;
+			}
+			int sizeClass = CLASSES_PER_DOUBLING * (shift - MIN_SHIFT);
+			while (GetClassSize(sizeClass) < size) {
+				++sizeClass;
+			}
+			return sizeClass;
+		}
+
+		int BufferPool::GetFloorClass(size_t capacity) {
+			if (capacity < GetClassSize(0)) {
+				return -1;
+			}
+			int sizeClass = GetClass(capacity);
+			return GetClassSize(sizeClass) > capacity ? sizeClass - 1 : sizeClass;
+		}
+
+		cv::MatAllocator* BufferPool::GetMatAllocator() {
+			return &matAllocator;
+		}
+
+		bool BufferPool::KeepIdle(size_t size) {
+			return stats.idleBytes + size <= static_cast<Poco::UInt64>(config.maxIdle) * 1024 * 1024;
+		}
+
+		void* BufferPool::AllocateBlock(size_t size, bool& mapped) {
+			mapped = false;
+#if defined(POCO_OS_FAMILY_UNIX) && defined(MADV_HUGEPAGE)
+			if (config.hugePages && size + HEADER_SIZE >= HUGE_PAGE) {
+				size_t length = (size + HEADER_SIZE + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+				void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (memory != MAP_FAILED) {
+					// only a hint, the kernel falls back to small pages if none are available
+					madvise(memory, length, MADV_HUGEPAGE);
+					mapped = true;
+					return memory;
+				}
+			}
+#endif
+			// aligned to CV_MALLOC_ALIGN, at least a cache line
+			return cv::fastMalloc(size + HEADER_SIZE);
+		}
+
+		void BufferPool::FreeBlock(BlockHeader* header) {
+#if defined(POCO_OS_FAMILY_UNIX)
+			if (header->mapped) {
+				munmap(header, (header->size + HEADER_SIZE + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE);
+				return;
+			}
+#endif
+			cv::fastFree(header);
+		}
+
+		void* BufferPool::Allocate(size_t size) {
+			int sizeClass = GetClass(size);
+			BlockHeader* header = nullptr;
+			{
+				Poco::FastMutex::ScopedLock lock(mutex);
+				vector<BlockHeader*>& idle = idleBlocks[sizeClass];
+				if (!idle.empty()) {
+					header = idle.back();
+					idle.pop_back();
+					stats.idleBytes -= header->size;
+					++stats.hits;
+				}
+				else {
+					++stats.misses;
+				}
+				stats.usedBytes += GetClassSize(sizeClass);
+			}
+
+			if (!header) {
+				size_t blockSize = GetClassSize(sizeClass);
+				bool mapped;
+				header = static_cast<BlockHeader*>(AllocateBlock(blockSize, mapped));
+				header->size = blockSize;
+				header->sizeClass = sizeClass;
+				header->mapped = mapped;
+			}
+
+			// released together with the block
+			duplicate();
+			return reinterpret_cast<uchar*>(header) + HEADER_SIZE;
+		}
+
+		void BufferPool::Release(void* block) {
+			BlockHeader* header = reinterpret_cast<BlockHeader*>(static_cast<uchar*>(block) - HEADER_SIZE);
+			bool keep;
+			{
+				Poco::FastMutex::ScopedLock lock(mutex);
+				stats.usedBytes -= header->size;
+				keep = KeepIdle(header->size);
+				if (keep) {
+					idleBlocks[header->sizeClass].push_back(header);
+					stats.idleBytes += header->size;
+				}
+				else {
+					++stats.freed;
+				}
+			}
+			if (!keep) {
+				FreeBlock(header);
+			}
+			release();
+		}
+
+		void BufferPool::Acquire(size_t size, vector<uchar>& buffer) {
+			Recycle(buffer);
+
+			int sizeClass = GetClass(size);
+			{
+				Poco::FastMutex::ScopedLock lock(mutex);
+				for (int c = sizeClass; c < CLASS_COUNT && c <= sizeClass + MAX_CLASS_SKIP; c++) {
+					vector<vector<uchar>>& idle = idleBuffers[c];
+					if (!idle.empty()) {
+						buffer.swap(idle.back());
+						idle.pop_back();
+						stats.idleBytes -= buffer.capacity();
+						++stats.hits;
+						return;
+					}
+				}
+				++stats.misses;
+			}
+			buffer.reserve(GetClassSize(sizeClass));
+		}
+
+		void BufferPool::Recycle(vector<uchar>& buffer) {
+			int sizeClass = GetFloorClass(buffer.capacity());
+			if (sizeClass < 0) {
+				return;
+			}
+
+			Poco::FastMutex::ScopedLock lock(mutex);
+			if (!KeepIdle(buffer.capacity())) {
+				++stats.freed;
+				vector<uchar>().swap(buffer);
+				return;
+			}
+			stats.idleBytes += buffer.capacity();
+			buffer.clear();
+			vector<vector<uchar>>& idle = idleBuffers[sizeClass];
+			idle.push_back(vector<uchar>());
+			idle.back().swap(buffer);
+		}
+
+		BufferPool::Stats BufferPool::GetStats() {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			return stats;
+		}
+
+		string BufferPool::ToString() {
+			Stats s = GetStats();
+			return "pool: " + std::to_string(s.hits) + " hits, " + std::to_string(s.misses) + " misses, " + std::to_string(s.freed) + " freed, " +
+				Poco::NumberFormatter::format(s.idleBytes / 1048576.0, 1) + " MB idle, " + Poco::NumberFormatter::format(s.usedBytes / 1048576.0, 1) + " MB used";
+		}
+	}
+}
@@ -0,0 +1,226 @@
+//============================================================================
+// Name        : CameraFrameSource.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Frame source reading from a local camera device
+//============================================================================
+#include "services/webcam/CameraFrameSource.h"
+#include "services/webcam/JpegStream.h"
+#include "services/webcam/YuvImage.h"
+
+#include "Poco\Logger.h"
+#include "Poco\Clock.h"
+
+using Poco::Logger;
+
+namespace services {
+	namespace webcam {
+		namespace {
+			const int FOURCC_YUYV = cv::VideoWriter::fourcc('Y', 'U', 'Y', 'V');
+			const int FOURCC_NV12 = cv::VideoWriter::fourcc('N', 'V', '1', '2');
+			const double FRESH_GRAB = 0.25; //share of the frame interval a grab has to block to count as fresh
+			const int MAX_DRAIN = 8; //stale frames drained per read at most, bounds the time spent on a fast device
+		}
+
+		CameraFrameSource::CameraFrameSource(int deviceIndex, double fps, int width, int height, bool lowLatency)
+			: deviceIndex(deviceIndex), fps(fps), width(width), height(height), lowLatency(lowLatency), passthrough(false), compressed(false), nativeYuv(false), yuvFormat(0), yuvWidth(0), yuvHeight(0), drained(0), capture(VideoCapture()) {
+		}
+
+		CameraFrameSource::~CameraFrameSource() {
+			Close();
+		}
+
+		bool CameraFrameSource::Open() {
+			Logger& logger = Logger::get("WebcamService");
+
+			capture.open(deviceIndex, cv::CAP_ANY);
+
+			if (!capture.isOpened()) {
+				logger.error("No camera available!");
+				return false;
+			}
+
+			//camera settings
+			// the pixel format has to be chosen before the resolution, drivers list sizes per format
+			compressed = passthrough && capture.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('M', 'J', 'P', 'G')) &&
+				capture.set(cv::CAP_PROP_CONVERT_RGB, 0);
+			if (passthrough && !compressed) {
+				capture.set(cv::CAP_PROP_CONVERT_RGB, 1);
+				logger.warning("Camera backend cannot deliver undecoded MJPEG, frames are decoded and re-encoded");
+			}
+			capture.set(cv::CAP_PROP_FPS, fps);
+			//Possible resolutions : 1280x720, 640x480; 440x330
+			if (width > 0 && height > 0) {
+				capture.set(cv::CAP_PROP_FRAME_WIDTH, width);
+				capture.set(cv::CAP_PROP_FRAME_HEIGHT, height);
+			}
+			drained = 0;
+
+			// JPEG from the device is forwarded as it is, so native YUV only matters without it
+			yuvFormat = 0;
+			if (nativeYuv && !compressed) {
+				int fourcc = static_cast<int>(capture.get(cv::CAP_PROP_FOURCC));
+				if ((fourcc == FOURCC_YUYV || fourcc == FOURCC_NV12) && capture.set(cv::CAP_PROP_CONVERT_RGB, 0)) {
+					yuvFormat = fourcc;
+					yuvWidth = GetWidth();
+					yuvHeight = GetHeight();
+				}
+				else {
+					logger.warning("Camera does not deliver YUYV or NV12 unconverted, frames are converted to BGR");
+				}
+			}
+			if (lowLatency && !capture.set(cv::CAP_PROP_BUFFERSIZE, 1)) {
+				logger.information("Camera backend ignores the buffer size, stale frames are drained instead");
+			}
+
+			logger.information("Camera settings: ");
+			logger.information("FPS: " + std::to_string(capture.get(cv::CAP_PROP_FPS)));
+			logger.information("Resolution: " + std::to_string(capture.get(cv::CAP_PROP_FRAME_WIDTH)) + "x" + std::to_string(capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
+			logger.information("Codec: " + std::to_string(capture.get(cv::CAP_PROP_FOURCC)));
+			logger.information("Format: " + std::to_string(capture.get(cv::CAP_PROP_FORMAT)));
+			logger.information(string("Passthrough: ") + (compressed ? "on" : "off"));
+			logger.information(string("Native YUV: ") + (yuvFormat != 0 ? "on" : "off"));
+			logger.information(string("Low latency: ") + (lowLatency ? "on, buffers: " + std::to_string(capture.get(cv::CAP_PROP_BUFFERSIZE)) : "off"));
+
+			return true;
+		}
+
+		void CameraFrameSource::Close() {
+			if (capture.isOpened()) {
+				capture.release();
+				if (lowLatency) {
+					Logger::get("WebcamService").information("Camera closed, " + std::to_string(drained) + " stale frames drained");
+				}
+			}
+		}
+
+		bool CameraFrameSource::IsOpened() {
+			return capture.isOpened();
+		}
+
+		bool CameraFrameSource::Read(Mat& frame) {
+			return capture.read(frame) && !frame.empty();
+		}
+
+		bool CameraFrameSource::Read(Mat& frame, Poco::Timestamp& captured) {
+			if (!lowLatency) {
+				return FrameSource::Read(frame, captured);
+			}
+			return Grab(captured) && capture.retrieve(frame) && !frame.empty();
+		}
+
+		bool CameraFrameSource::Grab(Poco::Timestamp& captured) {
+			if (!lowLatency) {
+				bool grabbed = capture.grab();
+				captured.update();
+				return grabbed;
+			}
+
+			// frames waiting in driver buffers come back at once, a grab that had to wait
+			// for the device got a fresh one. Only that one is decoded.
+			const Poco::Clock::ClockDiff fresh = static_cast<Poco::Clock::ClockDiff>(1000000 / (fps > 0 ? fps : 30) * FRESH_GRAB);
+			Poco::Clock grabStart;
+			if (!capture.grab()) {
+				return false;
+			}
+			for (int i = 0; i < MAX_DRAIN && !grabStart.isElapsed(fresh); i++) {
+				grabStart.update();
+				if (!capture.grab()) {
+					return false;
+				}
+				++drained;
+			}
+			captured.update();
+			return true;
+		}
+
+		bool CameraFrameSource::IsSelfPaced() {
+			return lowLatency;
+		}
+
+		bool CameraFrameSource::SetPassthrough(bool enable) {
+			passthrough = enable;
+			return true;
+		}
+
+		bool CameraFrameSource::IsPassthrough() {
+			return compressed;
+		}
+
+		bool CameraFrameSource::ReadCompressed(vector<uchar>& jpeg, Poco::Timestamp& captured) {
+			if (!compressed || !Grab(captured) || !capture.retrieve(raw) || raw.empty()) {
+				return false;
+			}
+
+			// without conversion the backend hands out the driver buffer as one row of bytes
+			if (!raw.isContinuous() || raw.depth() != CV_8U) {
+				StopRawFrames("unexpected buffer layout for JPEG");
+				return false;
+			}
+			const uchar* data = raw.ptr();
+			size_t size = raw.total() * raw.elemSize();
+			if (!JpegStream::IsJpeg(data, size)) {
+				StopRawFrames("camera does not deliver JPEG");
+				return false;
+			}
+
+			jpeg.assign(data, data + size);
+			return JpegStream::AddDefaultHuffmanTables(jpeg);
+		}
+
+		bool CameraFrameSource::SetNativeYUV(bool enable) {
+			nativeYuv = enable;
+			return true;
+		}
+
+		bool CameraFrameSource::IsNativeYUV() {
+			return yuvFormat != 0;
+		}
+
+		bool CameraFrameSource::ReadYUV(Mat& yuv, Poco::Timestamp& captured) {
+			if (yuvFormat == 0 || !Grab(captured) || !capture.retrieve(raw) || raw.empty()) {
+				return false;
+			}
+
+			// backends hand out the driver buffer either as one row of bytes or as a picture
+			// of two byte pixels, only the amount of data tells whether it is complete
+			size_t size = raw.total() * raw.elemSize();
+			if (!raw.isContinuous() || raw.depth() != CV_8U) {
+				StopRawFrames("unexpected buffer layout for YUV");
+				return false;
+			}
+			if (yuvFormat == FOURCC_YUYV && size >= static_cast<size_t>(yuvWidth) * yuvHeight * 2) {
+				return YuvImage::FromYUYV(raw.ptr(), yuvWidth, yuvHeight, static_cast<size_t>(yuvWidth) * 2, yuv);
+			}
+			if (yuvFormat == FOURCC_NV12 && size >= static_cast<size_t>(yuvWidth) * yuvHeight * 3 / 2) {
+				return YuvImage::FromNV12(raw.ptr(), yuvWidth, yuvHeight, yuv);
+			}
+			StopRawFrames("incomplete YUV frame of " + std::to_string(size) + " bytes");
+			return false;
+		}
+
+		void CameraFrameSource::StopRawFrames(const string& reason) {
+			Logger::get("WebcamService").warning(reason + ", frames are converted to BGR from now on");
+			compressed = false;
+			yuvFormat = 0;
+			capture.set(cv::CAP_PROP_CONVERT_RGB, 1);
+		}
+
+		double CameraFrameSource::GetFPS() {
+			// the requested rate, the driver may deliver slower but is never read faster
+			return fps;
+		}
+
+		int CameraFrameSource::GetWidth() {
+			return static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH));
+		}
+
+		int CameraFrameSource::GetHeight() {
+			return static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+		}
+
+		string CameraFrameSource::GetName() {
+			return "camera " + std::to_string(deviceIndex);
+		}
+	}
+}
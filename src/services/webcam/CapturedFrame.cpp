@@ -0,0 +1,32 @@
+//============================================================================
+// Name        : CapturedFrame.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Read-only, reference counted handle of a captured frame
+//============================================================================
+#include "services/webcam/CapturedFrame.h"
+
+namespace services {
+	namespace webcam {
+		CapturedFrame::CapturedFrame(const RawFrame& frame) : frame(frame), decoded(false) {
+		}
+
+		CapturedFrame::~CapturedFrame() {
+		}
+
+		cv::Size CapturedFrame::GetSize() const {
+			return frame.GetSize();
+		}
+
+		const Mat& CapturedFrame::GetImage() const {
+			if (!decoded) {
+				Poco::FastMutex::ScopedLock lock(decodeMutex);
+				if (!decoded) {
+					frame.Decode();
+					decoded = true;
+				}
+			}
+			return frame.image;
+		}
+	}
+}
@@ -0,0 +1,29 @@
+//============================================================================
+// Name        : EncodedFrame.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Immutable, reference counted JPEG frame shared by all viewers
+//============================================================================
+#include "services/webcam/EncodedFrame.h"
+
+#include <utility>
+
+namespace services {
+	namespace webcam {
+		EncodedFrame::EncodedFrame(Poco::UInt64 sequence, const Poco::Timestamp& timestamp, vector<unsigned char>& data,
+			BufferPool::Ptr pool) : sequence(sequence), timestamp(timestamp), data(std::move(data)), pool(pool),
+			bytes(this->data.data()), size(this->data.size()) {
+			data.clear();
+		}
+
+		EncodedFrame::EncodedFrame(Poco::UInt64 sequence, EncodedFrame::Ptr source)
+			: sequence(sequence), timestamp(source->GetTimestamp()), pool(nullptr), source(source), bytes(source->GetData()), size(source->GetSize()) {
+		}
+
+		EncodedFrame::~EncodedFrame() {
+			if (pool) {
+				pool->Recycle(data);
+			}
+		}
+	}
+}
@@ -0,0 +1,177 @@
+//============================================================================
+// Name        : EncodingGovernor.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Keeps the pipeline within a CPU budget by lowering JPEG quality
+//               and then frame rate under load and raising them again later
+//============================================================================
+#include "services/webcam/EncodingGovernor.h"
+
+#include "Poco\NumberFormatter.h"
+
+#include <algorithm>
+
+#if defined(POCO_OS_FAMILY_WINDOWS)
+#include "Poco\UnWindows.h"
+#else
+#include <sys/resource.h>
+#endif
+
+namespace services {
+	namespace webcam {
+		namespace {
+			const double FPS_STEPS = 4; //the frame rate moves in quarters of the source rate
+		}
+
+		EncodingGovernor::EncodingGovernor(const Config& config) : config(config) {
+			state.enabled = config.enabled;
+			state.adjustments = 0;
+			Reset(15);
+		}
+
+		void EncodingGovernor::Reset(double sourceFps) {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			state.qualityDrop = 0;
+			state.fps = sourceFps;
+			state.sourceFps = sourceFps;
+			state.load = 0;
+			state.encodeLoad = 0;
+			state.captureLoad = 0;
+			state.cpuPercent = 0;
+			periodStart.update();
+			periodCpu = GetProcessTime();
+			periodFrames = 0;
+			slackSum = 0;
+			slackCount = 0;
+			quietPeriods = 0;
+		}
+
+		void EncodingGovernor::RecordSlack(Poco::Clock::ClockDiff slackUs) {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			slackSum += slackUs;
+			++slackCount;
+		}
+
+		bool EncodingGovernor::Update(double encodeAverageMs, Poco::UInt64 encodedFrames) {
+			Poco::FastMutex::ScopedLock lock(mutex);
+
+			Poco::Clock::ClockDiff elapsed = periodStart.elapsed();
+			if (elapsed < static_cast<Poco::Clock::ClockDiff>(config.period) * 1000) {
+				return false;
+			}
+
+			Poco::Int64 cpu = GetProcessTime();
+			state.cpuPercent = 100.0 * (cpu - periodCpu) / elapsed;
+			double intervalMs = 1000.0 / state.fps;
+			bool encoded = encodedFrames != periodFrames;
+			state.encodeLoad = encoded ? encodeAverageMs / intervalMs : 0;
+			state.captureLoad = slackCount > 0 ? 1.0 - slackSum / 1000.0 / slackCount / intervalMs : 0;
+			state.load = std::max(state.encodeLoad, state.captureLoad);
+			if (config.cpuBudget > 0) {
+				state.load = std::max(state.load, state.cpuPercent / config.cpuBudget);
+			}
+
+			periodStart.update();
+			periodCpu = cpu;
+			periodFrames = encodedFrames;
+			slackSum = 0;
+			slackCount = 0;
+
+			// nothing to judge while suspended, the idle load would only step up
+			if (!config.enabled || !encoded) {
+				quietPeriods = 0;
+				return false;
+			}
+
+			int qualityDrop = state.qualityDrop;
+			double fps = state.fps;
+			if (state.load > config.highLoad) {
+				quietPeriods = 0;
+				StepDown();
+			}
+			else if (state.load < config.lowLoad) {
+				if (++quietPeriods >= config.holdPeriods) {
+					quietPeriods = 0;
+					StepUp();
+				}
+			}
+			else {
+				quietPeriods = 0;
+			}
+
+			if (qualityDrop == state.qualityDrop && fps == state.fps) {
+				return false;
+			}
+			++state.adjustments;
+			return true;
+		}
+
+		void EncodingGovernor::StepDown() {
+			int maxDrop = std::max(0, 100 - config.minQuality);
+			if (state.qualityDrop < maxDrop) {
+				state.qualityDrop = std::min(maxDrop, state.qualityDrop + config.qualityStep);
+			}
+			else {
+				state.fps = std::max(std::min(config.minFps, state.sourceFps), state.fps - state.sourceFps / FPS_STEPS);
+			}
+		}
+
+		void EncodingGovernor::StepUp() {
+			// frame rate first, it was taken away last
+			if (state.fps < state.sourceFps) {
+				state.fps = std::min(state.sourceFps, state.fps + state.sourceFps / FPS_STEPS);
+			}
+			else if (state.qualityDrop > 0) {
+				state.qualityDrop = std::max(0, state.qualityDrop - config.qualityStep);
+			}
+		}
+
+		int EncodingGovernor::GetQuality(int requested) {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			if (state.qualityDrop == 0) {
+				return requested;
+			}
+			return std::min(requested, std::max(config.minQuality, requested - state.qualityDrop));
+		}
+
+		double EncodingGovernor::GetFPS() {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			return state.fps;
+		}
+
+		EncodingGovernor::State EncodingGovernor::GetState() {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			return state;
+		}
+
+		string EncodingGovernor::ToString() {
+			State s = GetState();
+			return "governor: load " + Poco::NumberFormatter::format(s.load, 2) + " (encode " + Poco::NumberFormatter::format(s.encodeLoad, 2) +
+				", capture " + Poco::NumberFormatter::format(s.captureLoad, 2) + ", cpu " + Poco::NumberFormatter::format(s.cpuPercent, 0) +
+				"%), quality -" + std::to_string(s.qualityDrop) + ", " + Poco::NumberFormatter::format(s.fps, 1) + " fps";
+		}
+
+		Poco::Int64 EncodingGovernor::GetProcessTime() {
+#if defined(POCO_OS_FAMILY_WINDOWS)
+			FILETIME creation, exit, kernel, user;
+			if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+				return 0;
+			}
+			ULARGE_INTEGER kernelTime, userTime;
+			kernelTime.LowPart = kernel.dwLowDateTime;
+			kernelTime.HighPart = kernel.dwHighDateTime;
+			userTime.LowPart = user.dwLowDateTime;
+			userTime.HighPart = user.dwHighDateTime;
+			// 100 ns units
+			return static_cast<Poco::Int64>((kernelTime.QuadPart + userTime.QuadPart) / 10);
+#else
+			struct rusage usage;
+			if (getrusage(RUSAGE_SELF, &usage) != 0) {
+				return 0;
+			}
+			return static_cast<Poco::Int64>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+				usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+#endif
+		}
+	}
+}
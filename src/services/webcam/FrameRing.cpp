@@ -0,0 +1,61 @@
+//============================================================================
+// Name        : FrameRing.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Fixed capacity history of the last encoded frames of a rendition
+//============================================================================
+#include "services/webcam/FrameRing.h"
+
+#include <algorithm>
+
+namespace services {
+	namespace webcam {
+		FrameRing::FrameRing(size_t capacity) : frames(capacity > 0 ? capacity : 1), sequence(0) {
+		}
+
+		void FrameRing::Add(EncodedFrame::Ptr frame) {
+			sequence = frame->GetSequence();
+			frames[sequence % frames.size()] = frame;
+		}
+
+		const EncodedFrame::Ptr& FrameRing::At(Poco::UInt64 sequence) const {
+			return frames[sequence % frames.size()];
+		}
+
+		Poco::UInt64 FrameRing::GetOldestSequence() const {
+			return sequence >= frames.size() ? sequence - frames.size() + 1 : 1;
+		}
+
+		EncodedFrame::Ptr FrameRing::GetLatest() const {
+			return sequence > 0 ? At(sequence) : EncodedFrame::Ptr();
+		}
+
+		EncodedFrame::Ptr FrameRing::GetAfter(Poco::UInt64 sequence) const {
+			if (sequence >= this->sequence) {
+				return EncodedFrame::Ptr();
+			}
+			return At(std::max(sequence + 1, GetOldestSequence()));
+		}
+
+		EncodedFrame::Ptr FrameRing::GetAfter(const Poco::Timestamp& captured) const {
+			if (sequence == 0) {
+				return EncodedFrame::Ptr();
+			}
+			// capture times grow with the sequence, so the first match is the oldest one
+			for (Poco::UInt64 i = GetOldestSequence(); i <= sequence; i++) {
+				if (At(i)->GetTimestamp() > captured) {
+					return At(i);
+				}
+			}
+			return EncodedFrame::Ptr();
+		}
+
+		Poco::UInt64 FrameRing::GetSequence() const {
+			return sequence;
+		}
+
+		size_t FrameRing::GetCapacity() const {
+			return frames.size();
+		}
+	}
+}
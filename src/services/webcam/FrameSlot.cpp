@@ -0,0 +1,66 @@
+//============================================================================
+// Name        : FrameSlot.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Lock-free slot holding the latest captured frame
+//============================================================================
+#include "services/webcam/FrameSlot.h"
+
+#include "Poco\Thread.h"
+
+namespace services {
+	namespace webcam {
+		FrameSlot::FrameSlot() : current(0), sequence(0) {
+			for (int i = 0; i < SLOTS; i++) {
+				pins[i] = 0;
+			}
+		}
+
+		void FrameSlot::Publish(CapturedFrame::Ptr frame) {
+			// The reader pins before it checks current, the writer moves current away before it
+			// checks the pins. With sequentially consistent atomics one of them sees the other,
+			// so a slot is never refilled while a reader copies from it.
+			int active = current;
+			int next = -1;
+			while (next < 0) {
+				for (int i = 1; i < SLOTS && next < 0; i++) {
+					int candidate = (active + i) % SLOTS;
+					if (pins[candidate] == 0) {
+						next = candidate;
+					}
+				}
+				if (next < 0) {
+					// both spare slots are pinned for the few instructions of a reference copy
+					Poco::Thread::yield();
+				}
+			}
+
+			// the frame replaced here lives on in the readers that still hold it
+			frames[next] = frame;
+			sequence = frame ? frame->GetSequence() : 0;
+			current = next;
+		}
+
+		CapturedFrame::Ptr FrameSlot::Get() const {
+			for (;;) {
+				int active = current;
+				++pins[active];
+				if (current == active) {
+					CapturedFrame::Ptr frame = frames[active];
+					--pins[active];
+					return frame;
+				}
+				// a newer frame was published meanwhile, its slot is safe to read now
+				--pins[active];
+			}
+		}
+
+		Poco::UInt64 FrameSlot::GetSequence() const {
+			return sequence;
+		}
+
+		void FrameSlot::Clear() {
+			Publish(nullptr);
+		}
+	}
+}
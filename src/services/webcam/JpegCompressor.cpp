@@ -0,0 +1,261 @@
+//============================================================================
+// Name        : JpegCompressor.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : libjpeg compressor kept alive across frames, encodes BGR and
+//               planar YCbCr 4:2:0 frames
+//============================================================================
+#include "services/webcam/JpegCompressor.h"
+#include "services/webcam/YuvImage.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+namespace services {
+	namespace webcam {
+		namespace {
+			const size_t INITIAL_OUTPUT = 64 * 1024; //in bytes, until the size of a frame is known
+			const int MCU_ROWS = 16;                 //luma rows per call of jpeg_write_raw_data, also scanlines per batch
+			const int MCU_COLUMNS = 16;              //libjpeg reads whole blocks, narrower rows are padded
+
+			// libjpeg exits the process on errors unless error_exit jumps out
+			struct ErrorManager {
+				jpeg_error_mgr pub;
+				jmp_buf jump;
+			};
+
+			void ExitOnError(j_common_ptr cinfo) {
+				longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->jump, 1);
+			}
+
+			void IgnoreMessage(j_common_ptr cinfo) {
+			}
+
+			// writes straight into the output vector instead of a malloc'd buffer
+			struct VectorDestination {
+				jpeg_destination_mgr pub;
+				vector<uchar>* output;
+				size_t initialSize;
+			};
+
+			void InitDestination(j_compress_ptr cinfo) {
+				VectorDestination* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+				dest->output->resize(std::max(dest->output->capacity(), dest->initialSize));
+				dest->pub.next_output_byte = dest->output->data();
+				dest->pub.free_in_buffer = dest->output->size();
+			}
+
+			boolean GrowDestination(j_compress_ptr cinfo) {
+				// called when the whole buffer is used up
+				VectorDestination* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+				size_t used = dest->output->size();
+				dest->output->resize(used * 2);
+				dest->pub.next_output_byte = dest->output->data() + used;
+				dest->pub.free_in_buffer = dest->output->size() - used;
+				return TRUE;
+			}
+
+			void TermDestination(j_compress_ptr cinfo) {
+				VectorDestination* dest = reinterpret_cast<VectorDestination*>(cinfo->dest);
+				dest->output->resize(dest->output->size() - dest->pub.free_in_buffer);
+			}
+
+			// row of a plane as libjpeg wants it, copied and padded with its last sample if the
+			// plane is not a whole number of blocks wide
+			JSAMPROW GetRow(const uchar* row, int width, int paddedWidth, uchar* scratch) {
+				if (width == paddedWidth) {
+					return const_cast<JSAMPROW>(row);
+				}
+				std::memcpy(scratch, row, width);
+				std::memset(scratch + width, row[width - 1], paddedWidth - width);
+				return scratch;
+			}
+		}
+
+		struct JpegCompressor::Context {
+			jpeg_compress_struct cinfo;
+			ErrorManager error;
+			VectorDestination dest;
+		};
+
+		JpegCompressor::Subsampling JpegCompressor::ParseSubsampling(const string& name) {
+			if (name == "444") {
+				return SUBSAMPLING_444;
+			}
+			if (name == "422") {
+				return SUBSAMPLING_422;
+			}
+			return SUBSAMPLING_420;
+		}
+
+		JpegCompressor::JpegCompressor(const Settings& settings) : settings(settings), context(new Context()), quality(0), lastSize(0) {
+			jpeg_compress_struct& cinfo = context->cinfo;
+			cinfo.err = jpeg_std_error(&context->error.pub);
+			context->error.pub.error_exit = ExitOnError;
+			context->error.pub.output_message = IgnoreMessage;
+			if (setjmp(context->error.jump)) {
+				// out of memory, Encode() reports every frame as failed
+				jpeg_destroy_compress(&cinfo);
+				delete context;
+				context = nullptr;
+				return;
+			}
+			jpeg_create_compress(&cinfo);
+
+			context->dest.pub.init_destination = InitDestination;
+			context->dest.pub.empty_output_buffer = GrowDestination;
+			context->dest.pub.term_destination = TermDestination;
+			cinfo.dest = &context->dest.pub;
+
+			// YCbCr output in any case, only the input colour space changes between calls
+			cinfo.input_components = 3;
+			cinfo.in_color_space = JCS_YCbCr;
+			jpeg_set_defaults(&cinfo);
+		}
+
+		JpegCompressor::~JpegCompressor() {
+			if (context) {
+				jpeg_destroy_compress(&context->cinfo);
+				delete context;
+			}
+		}
+
+		const JpegCompressor::Settings& JpegCompressor::GetSettings() const {
+			return settings;
+		}
+
+		void JpegCompressor::Prepare(int width, int height, int quality, bool rawData, vector<uchar>& output) {
+			jpeg_compress_struct& cinfo = context->cinfo;
+			cinfo.image_width = width;
+			cinfo.image_height = height;
+			cinfo.raw_data_in = rawData ? TRUE : FALSE;
+#ifdef JCS_EXTENSIONS
+			cinfo.in_color_space = rawData ? JCS_YCbCr : JCS_EXT_BGR;
+#else
+			cinfo.in_color_space = rawData ? JCS_YCbCr : JCS_RGB;
+#endif
+			if (quality != this->quality) {
+				jpeg_set_quality(&cinfo, quality, TRUE);
+				this->quality = quality;
+			}
+
+			// the chroma planes of raw data are already 4:2:0
+			Subsampling subsampling = rawData ? SUBSAMPLING_420 : settings.subsampling;
+			cinfo.comp_info[0].h_samp_factor = subsampling == SUBSAMPLING_444 ? 1 : 2;
+			cinfo.comp_info[0].v_samp_factor = subsampling == SUBSAMPLING_420 ? 2 : 1;
+			for (int i = 1; i < 3; i++) {
+				cinfo.comp_info[i].h_samp_factor = 1;
+				cinfo.comp_info[i].v_samp_factor = 1;
+			}
+			cinfo.optimize_coding = settings.optimizeHuffman ? TRUE : FALSE;
+			cinfo.restart_interval = 0;
+			cinfo.restart_in_rows = settings.restartRows;
+
+			// frames of a stream hardly change in size, start with some headroom over the last one
+			context->dest.output = &output;
+			context->dest.initialSize = lastSize > 0 ? lastSize + lastSize / 4 : INITIAL_OUTPUT;
+		}
+
+		bool JpegCompressor::Encode(const Mat& image, int quality, vector<uchar>& output) {
+			if (!context || image.empty() || image.type() != CV_8UC3) {
+				return false;
+			}
+
+			jpeg_compress_struct& cinfo = context->cinfo;
+			if (setjmp(context->error.jump)) {
+				// leaves the compressor ready for the next frame
+				jpeg_abort_compress(&cinfo);
+				return false;
+			}
+			Prepare(image.cols, image.rows, quality, false, output);
+#ifndef JCS_EXTENSIONS
+			scratch.resize(static_cast<size_t>(image.cols) * 3 * MCU_ROWS);
+#endif
+
+			JSAMPROW rows[MCU_ROWS];
+			jpeg_start_compress(&cinfo, TRUE);
+			while (cinfo.next_scanline < cinfo.image_height) {
+				int count = std::min(MCU_ROWS, static_cast<int>(cinfo.image_height - cinfo.next_scanline));
+				for (int i = 0; i < count; i++) {
+					const uchar* row = image.ptr(cinfo.next_scanline + i);
+#ifdef JCS_EXTENSIONS
+					rows[i] = const_cast<JSAMPROW>(row);
+#else
+					// plain libjpeg only knows RGB
+					uchar* rgb = scratch.data() + static_cast<size_t>(i) * image.cols * 3;
+					for (int x = 0; x < image.cols; x++) {
+						rgb[3 * x] = row[3 * x + 2];
+						rgb[3 * x + 1] = row[3 * x + 1];
+						rgb[3 * x + 2] = row[3 * x];
+					}
+					rows[i] = rgb;
+#endif
+				}
+				jpeg_write_scanlines(&cinfo, rows, count);
+			}
+			jpeg_finish_compress(&cinfo);
+			lastSize = output.size();
+			return true;
+		}
+
+		bool JpegCompressor::EncodeYUV(const Mat& yuv, const cv::Range& rows, int quality, vector<uchar>& output) {
+			cv::Size size = YuvImage::GetSize(yuv);
+			if (!context || !YuvImage::IsValid(yuv) || rows.start % 2 != 0 || rows.start < 0 || rows.end > size.height || rows.size() <= 0) {
+				return false;
+			}
+
+			const int width = size.width;
+			const int height = rows.size();
+			const int chromaWidth = width / 2;
+			const int chromaHeight = (height + 1) / 2;
+			const int paddedWidth = (width + MCU_COLUMNS - 1) / MCU_COLUMNS * MCU_COLUMNS;
+			const int paddedChromaWidth = paddedWidth / 2;
+			const uchar* yPlane = YuvImage::GetY(yuv) + static_cast<size_t>(rows.start) * width;
+			const uchar* uPlane = YuvImage::GetU(yuv) + static_cast<size_t>(rows.start / 2) * chromaWidth;
+			const uchar* vPlane = YuvImage::GetV(yuv) + static_cast<size_t>(rows.start / 2) * chromaWidth;
+
+			if (paddedWidth != width) {
+				scratch.resize(static_cast<size_t>(paddedWidth) * MCU_ROWS * 3 / 2);
+			}
+			uchar* yScratch = scratch.data();
+			uchar* uScratch = yScratch + static_cast<size_t>(paddedWidth) * MCU_ROWS;
+			uchar* vScratch = uScratch + static_cast<size_t>(paddedChromaWidth) * MCU_ROWS / 2;
+
+			JSAMPROW yRows[MCU_ROWS];
+			JSAMPROW uRows[MCU_ROWS / 2];
+			JSAMPROW vRows[MCU_ROWS / 2];
+			JSAMPARRAY planes[] = { yRows, uRows, vRows };
+
+			jpeg_compress_struct& cinfo = context->cinfo;
+			if (setjmp(context->error.jump)) {
+				jpeg_abort_compress(&cinfo);
+				return false;
+			}
+			Prepare(width, height, quality, true, output);
+
+			jpeg_start_compress(&cinfo, TRUE);
+			for (int row = 0; row < height; row += MCU_ROWS) {
+				// rows below the picture repeat the last one, like libjpeg pads itself
+				for (int i = 0; i < MCU_ROWS; i++) {
+					int r = std::min(row + i, height - 1);
+					yRows[i] = GetRow(yPlane + static_cast<size_t>(r) * width, width, paddedWidth, yScratch + static_cast<size_t>(i) * paddedWidth);
+				}
+				for (int i = 0; i < MCU_ROWS / 2; i++) {
+					int r = std::min(row / 2 + i, chromaHeight - 1);
+					uRows[i] = GetRow(uPlane + static_cast<size_t>(r) * chromaWidth, chromaWidth, paddedChromaWidth, uScratch + static_cast<size_t>(i) * paddedChromaWidth);
+					vRows[i] = GetRow(vPlane + static_cast<size_t>(r) * chromaWidth, chromaWidth, paddedChromaWidth, vScratch + static_cast<size_t>(i) * paddedChromaWidth);
+				}
+				jpeg_write_raw_data(&cinfo, planes, MCU_ROWS);
+			}
+			jpeg_finish_compress(&cinfo);
+			lastSize = output.size();
+			return true;
+		}
+	}
+}
@@ -0,0 +1,144 @@
+//============================================================================
+// Name        : JpegStream.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Inspects and patches JPEG bitstreams without decoding them
+//============================================================================
+#include "services/webcam/JpegStream.h"
+
+#include <algorithm>
+
+namespace services {
+	namespace webcam {
+		namespace {
+			const uchar MARKER = 0xFF;
+			const uchar SOI = 0xD8;
+			const uchar SOS = 0xDA;
+			const uchar DHT = 0xC4;
+			const uchar SOF[] = { 0xC0, 0xC1, 0xC2, 0xC3, 0xC5, 0xC6, 0xC7, 0xC9, 0xCA, 0xCB, 0xCD, 0xCE, 0xCF };
+
+			// ITU T.81 Annex K.3, class and id byte followed by the code counts per length and the values
+			const uchar DEFAULT_HUFFMAN_TABLES[] = {
+				// DC luminance
+				0x00,
+				0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+				// AC luminance
+				0x10,
+				0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04, 0x00, 0x00, 0x01, 0x7d,
+				0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+				0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+				0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+				0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+				0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+				0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+				0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+				0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+				0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+				0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+				0xf9, 0xfa,
+				// DC chrominance
+				0x01,
+				0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+				0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+				// AC chrominance
+				0x11,
+				0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04, 0x00, 0x01, 0x02, 0x77,
+				0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+				0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+				0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+				0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+				0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+				0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+				0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+				0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+				0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+				0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+				0xf9, 0xfa
+			};
+		}
+
+		bool JpegStream::IsJpeg(const uchar* data, size_t size) {
+			return size > 2 && data[0] == MARKER && data[1] == SOI;
+		}
+
+		bool JpegStream::FindMarker(const uchar* jpeg, size_t size, const uchar* markers, size_t count, size_t& offset, size_t& sos) {
+			if (!IsJpeg(jpeg, size)) {
+				return false;
+			}
+
+			offset = 0;
+			size_t pos = 2;
+			while (pos + 1 < size) {
+				if (jpeg[pos] != MARKER) {
+					return false;
+				}
+				// any number of fill bytes may precede a marker
+				while (pos + 1 < size && jpeg[pos + 1] == MARKER) {
+					++pos;
+				}
+				if (pos + 1 >= size) {
+					return false;
+				}
+
+				uchar marker = jpeg[pos + 1];
+				if (marker == SOS) {
+					sos = pos;
+					if (offset == 0) {
+						offset = pos;
+					}
+					return true;
+				}
+				if (offset == 0 && std::find(markers, markers + count, marker) != markers + count) {
+					offset = pos;
+				}
+
+				// TEM and RSTn stand alone, everything else carries a length
+				if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+					pos += 2;
+					continue;
+				}
+				if (pos + 3 >= size) {
+					return false;
+				}
+				size_t length = (static_cast<size_t>(jpeg[pos + 2]) << 8) | jpeg[pos + 3];
+				if (length < 2) {
+					return false;
+				}
+				pos += 2 + length;
+			}
+			return false;
+		}
+
+		bool JpegStream::GetSize(const uchar* jpeg, size_t length, cv::Size& size) {
+			size_t offset, sos;
+			if (!FindMarker(jpeg, length, SOF, sizeof(SOF), offset, sos) || offset == sos || offset + 8 >= length) {
+				return false;
+			}
+			// length, precision, then height and width
+			int height = (jpeg[offset + 5] << 8) | jpeg[offset + 6];
+			int width = (jpeg[offset + 7] << 8) | jpeg[offset + 8];
+			if (width <= 0 || height <= 0) {
+				return false;
+			}
+			size = cv::Size(width, height);
+			return true;
+		}
+
+		bool JpegStream::AddDefaultHuffmanTables(vector<uchar>& jpeg) {
+			size_t offset, sos;
+			if (!FindMarker(jpeg.data(), jpeg.size(), &DHT, 1, offset, sos)) {
+				return false;
+			}
+			if (offset != sos) {
+				return true;
+			}
+
+			const size_t length = 2 + sizeof(DEFAULT_HUFFMAN_TABLES);
+			const uchar header[] = { MARKER, DHT, static_cast<uchar>(length >> 8), static_cast<uchar>(length & 0xFF) };
+			jpeg.insert(jpeg.begin() + sos, DEFAULT_HUFFMAN_TABLES, DEFAULT_HUFFMAN_TABLES + sizeof(DEFAULT_HUFFMAN_TABLES));
+			jpeg.insert(jpeg.begin() + sos, header, header + sizeof(header));
+			return true;
+		}
+	}
+}
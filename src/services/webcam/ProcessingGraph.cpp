@@ -0,0 +1,228 @@
+//============================================================================
+// Name        : ProcessingGraph.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Processing stages fed from the capture thread, each on its own worker
+//============================================================================
+#include "services/webcam/ProcessingGraph.h"
+#include "services/webcam/WebcamService.h"
+
+#include "Poco\Clock.h"
+#include "Poco\Logger.h"
+#include "Poco\Exception.h"
+#include "Poco\NumberFormatter.h"
+
+#include <algorithm>
+#include <exception>
+
+using Poco::Logger;
+
+namespace services {
+	namespace webcam {
+		namespace {
+			const long POP_TIMEOUT = 100; //in ms, bounds the reaction to Stop()
+		}
+
+		ProcessingGraph::Worker::Worker(ProcessingGraph& graph, ProcessingStage::Ptr stage, const string& name, const string& upstream, size_t queueSize)
+			: name(name), upstream(upstream), graph(graph), stage(stage), running(false), queue(queueSize),
+			processStats(name), latencyStats(name + " latency"), thread("Stage " + name), adapter(*this, &Worker::Run) {
+		}
+
+		ProcessingGraph::Worker::~Worker() {
+			Stop();
+		}
+
+		void ProcessingGraph::Worker::Start() {
+			running = true;
+			thread.start(adapter);
+		}
+
+		void ProcessingGraph::Worker::Stop() {
+			if (!thread.isRunning()) {
+				return;
+			}
+			running = false;
+			queue.Wake();
+			thread.join();
+		}
+
+		void ProcessingGraph::Worker::Push(CapturedFrame::Ptr frame) {
+			if (!queue.Push(frame)) {
+				processStats.RecordDrop();
+			}
+		}
+
+		ProcessingGraph::StageStatus ProcessingGraph::Worker::GetStatus() {
+			StageStatus status;
+			status.name = name;
+			status.upstream = upstream;
+			status.queued = queue.Size();
+			status.process = processStats.GetSnapshot();
+			status.latency = latencyStats.GetSnapshot();
+			return status;
+		}
+
+		void ProcessingGraph::Worker::ResetMax() {
+			processStats.ResetMax();
+			latencyStats.ResetMax();
+		}
+
+		void ProcessingGraph::Worker::Run() {
+			Poco::Clock start;
+			CapturedFrame::Ptr frame;
+
+			while (running) {
+				if (!queue.Pop(frame, POP_TIMEOUT)) {
+					continue;
+				}
+
+				start.update();
+				CapturedFrame::Ptr result;
+				try {
+					result = stage->Process(frame);
+				}
+				catch (Poco::Exception& e) {
+					Logger::get("ProcessingGraph").warning("stage " + name + " failed on frame " + std::to_string(frame->GetSequence()) + ": " + e.displayText());
+				}
+				catch (std::exception& e) {
+					Logger::get("ProcessingGraph").warning("stage " + name + " failed on frame " + std::to_string(frame->GetSequence()) + ": " + e.what());
+				}
+				processStats.Record(start.elapsed());
+				latencyStats.Record(frame->GetCaptured().elapsed());
+
+				if (result) {
+					graph.Dispatch(name, result);
+				}
+				// do not keep the frame alive until the next one arrives
+				frame = nullptr;
+			}
+		}
+
+		ProcessingGraph::ProcessingGraph(const Config& config) : config(config), workers(new Workers()) {
+		}
+
+		ProcessingGraph::~ProcessingGraph() {
+			RemoveAll();
+		}
+
+		Poco::SharedPtr<ProcessingGraph::Workers> ProcessingGraph::GetWorkers() {
+			Poco::FastMutex::ScopedLock lock(workersMutex);
+			return workers;
+		}
+
+		bool ProcessingGraph::AddStage(ProcessingStage::Ptr stage, const string& upstream) {
+			Poco::FastMutex::ScopedLock change(changeMutex);
+			const string name = stage->GetName();
+			bool upstreamFound = upstream.empty();
+			for (auto& worker : *workers) {
+				if (worker->name == name) {
+					return false;
+				}
+				upstreamFound = upstreamFound || worker->name == upstream;
+			}
+			if (!upstreamFound) {
+				return false;
+			}
+
+			Poco::SharedPtr<Worker> worker = new Worker(*this, stage, name, upstream, config.queueSize);
+			worker->Start();
+
+			Poco::SharedPtr<Workers> changed = new Workers(*workers);
+			changed->push_back(worker);
+			{
+				Poco::FastMutex::ScopedLock lock(workersMutex);
+				workers = changed;
+			}
+			Logger::get("ProcessingGraph").information("added stage " + name + (upstream.empty() ? "" : " after " + upstream));
+			return true;
+		}
+
+		bool ProcessingGraph::RemoveStage(const string& name) {
+			Poco::FastMutex::ScopedLock change(changeMutex);
+
+			// stages are only added after their upstream stage, so one pass finds all descendants
+			vector<string> removedNames(1, name);
+			Workers removed;
+			Poco::SharedPtr<Workers> changed = new Workers();
+			for (auto& worker : *workers) {
+				if (std::find(removedNames.begin(), removedNames.end(), worker->name) != removedNames.end() ||
+					std::find(removedNames.begin(), removedNames.end(), worker->upstream) != removedNames.end()) {
+					removedNames.push_back(worker->name);
+					removed.push_back(worker);
+				}
+				else {
+					changed->push_back(worker);
+				}
+			}
+			if (removed.empty()) {
+				return false;
+			}
+
+			{
+				Poco::FastMutex::ScopedLock lock(workersMutex);
+				workers = changed;
+			}
+			// Dispatch() calls that still hold the old list only queue frames nobody pops
+			for (auto& worker : removed) {
+				worker->Stop();
+				Logger::get("ProcessingGraph").information("removed stage " + worker->name);
+			}
+			return true;
+		}
+
+		void ProcessingGraph::RemoveAll() {
+			Poco::SharedPtr<Workers> current = GetWorkers();
+			for (auto& worker : *current) {
+				if (worker->upstream.empty()) {
+					RemoveStage(worker->name);
+				}
+			}
+		}
+
+		void ProcessingGraph::Update(WebcamService* service) {
+			if (GetWorkers()->empty()) {
+				return;
+			}
+			CapturedFrame::Ptr frame = service->GetLatestFrame();
+			if (frame) {
+				Dispatch("", frame);
+			}
+		}
+
+		void ProcessingGraph::Dispatch(const string& upstream, CapturedFrame::Ptr frame) {
+			Poco::SharedPtr<Workers> current = GetWorkers();
+			for (auto& worker : *current) {
+				if (worker->upstream == upstream) {
+					worker->Push(frame);
+				}
+			}
+		}
+
+		vector<ProcessingGraph::StageStatus> ProcessingGraph::GetStatus() {
+			vector<StageStatus> status;
+			Poco::SharedPtr<Workers> current = GetWorkers();
+			for (auto& worker : *current) {
+				status.push_back(worker->GetStatus());
+			}
+			return status;
+		}
+
+		void ProcessingGraph::ResetMax() {
+			Poco::SharedPtr<Workers> current = GetWorkers();
+			for (auto& worker : *current) {
+				worker->ResetMax();
+			}
+		}
+
+		string ProcessingGraph::ToString() {
+			string result;
+			vector<StageStatus> status = GetStatus();
+			for (auto& stage : status) {
+				result += (result.empty() ? "" : "; ") + string("stage ") + stage.name + ": " + std::to_string(stage.process.frames) + " frames, " +
+					std::to_string(stage.process.dropped) + " dropped, " + Poco::NumberFormatter::format(stage.process.averageMs, 1) + " ms avg, " +
+					Poco::NumberFormatter::format(stage.process.maxMs, 1) + " ms max, " + Poco::NumberFormatter::format(stage.latency.averageMs, 1) + " ms from capture";
+			}
+			return result;
+		}
+	}
+}
@@ -0,0 +1,39 @@
+//============================================================================
+// Name        : RawFrame.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Captured, not yet encoded frame passed between pipeline stages
+//============================================================================
+#include "services/webcam/RawFrame.h"
+#include "services/webcam/JpegStream.h"
+#include "services/webcam/YuvImage.h"
+
+#include "opencv2\imgcodecs.hpp"
+#include "opencv2\imgproc.hpp"
+
+namespace services {
+	namespace webcam {
+		bool RawFrame::Decode() {
+			if (image.empty() && !yuv.empty()) {
+				cv::cvtColor(yuv, image, cv::COLOR_YUV2BGR_I420);
+			}
+			else if (image.empty() && compressed && compressed->GetSize() > 0) {
+				// decoding into image keeps its allocator, so pooled frames stay pooled
+				Mat data(1, static_cast<int>(compressed->GetSize()), CV_8UC1, const_cast<uchar*>(compressed->GetData()));
+				cv::imdecode(data, cv::IMREAD_COLOR, &image);
+			}
+			return !image.empty();
+		}
+
+		cv::Size RawFrame::GetSize() const {
+			cv::Size size;
+			if (!yuv.empty()) {
+				return YuvImage::GetSize(yuv);
+			}
+			if (image.empty() && compressed && JpegStream::GetSize(compressed->GetData(), compressed->GetSize(), size)) {
+				return size;
+			}
+			return image.size();
+		}
+	}
+}
@@ -0,0 +1,223 @@
+//============================================================================
+// Name        : ReplayFrameSource.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Replays a video file or a directory of JPEG images
+//============================================================================
+#include "services/webcam/ReplayFrameSource.h"
+#include "services/webcam/JpegStream.h"
+
+#include "Poco\Logger.h"
+#include "Poco\File.h"
+#include "Poco\Path.h"
+#include "Poco\DirectoryIterator.h"
+#include "Poco\String.h"
+#include "Poco\FileStream.h"
+
+#include <algorithm>
+#include <iterator>
+
+using Poco::Logger;
+
+namespace services {
+	namespace webcam {
+		ReplayFrameSource::ReplayFrameSource(const string& path, double fps, bool loop)
+			: path(path), fps(fps), loop(loop), isDirectory(false), isOpened(false), passthrough(false), compressed(false), width(0), height(0), capture(VideoCapture()), nextFile(0) {
+		}
+
+		ReplayFrameSource::~ReplayFrameSource() {
+			Close();
+		}
+
+		bool ReplayFrameSource::Open() {
+			Logger& logger = Logger::get("WebcamService");
+
+			Poco::File file(path);
+			if (!file.exists()) {
+				logger.error("Replay source not found: " + path);
+				return false;
+			}
+
+			isDirectory = file.isDirectory();
+			if (isDirectory) {
+				files.clear();
+				for (Poco::DirectoryIterator it(path), end; it != end; ++it) {
+					string ext = Poco::toLower(it.path().getExtension());
+					if (it->isFile() && (ext == "jpg" || ext == "jpeg")) {
+						files.push_back(it.path().toString());
+					}
+				}
+				std::sort(files.begin(), files.end());
+
+				if (files.empty()) {
+					logger.error("No JPEG images in replay directory: " + path);
+					return false;
+				}
+
+				Mat first = cv::imread(files.front(), cv::IMREAD_COLOR);
+				if (first.empty()) {
+					logger.error("Cannot decode replay image: " + files.front());
+					return false;
+				}
+				width = first.cols;
+				height = first.rows;
+				nextFile = 0;
+				compressed = passthrough;
+			}
+			else {
+				if (!OpenFile()) {
+					logger.error("Cannot open replay file: " + path);
+					return false;
+				}
+				if (passthrough && !compressed) {
+					logger.warning("Video backend cannot deliver undecoded frames, frames are decoded and re-encoded");
+				}
+
+				double fileFps = capture.get(cv::CAP_PROP_FPS);
+				if (fileFps > 0) {
+					fps = fileFps;
+				}
+				width = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH));
+				height = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+			}
+
+			isOpened = true;
+
+			logger.information("Replay source: " + GetName() + " " + std::to_string(width) + "x" + std::to_string(height) + " @ " + std::to_string(fps) + " FPS" +
+				(compressed ? ", passthrough" : ""));
+
+			return true;
+		}
+
+		void ReplayFrameSource::Close() {
+			if (capture.isOpened()) {
+				capture.release();
+			}
+			files.clear();
+			isOpened = false;
+		}
+
+		bool ReplayFrameSource::IsOpened() {
+			return isOpened;
+		}
+
+		bool ReplayFrameSource::Read(Mat& frame) {
+			if (!isOpened) {
+				return false;
+			}
+
+			return isDirectory ? ReadDirectory(frame) : ReadFile(frame);
+		}
+
+		bool ReplayFrameSource::ReadFile(Mat& frame) {
+			if (capture.read(frame) && !frame.empty()) {
+				return true;
+			}
+
+			if (!loop) {
+				isOpened = false;
+				return false;
+			}
+
+			// rewind, some backends cannot seek so reopen as a fallback
+			if (!capture.set(cv::CAP_PROP_POS_FRAMES, 0)) {
+				capture.release();
+				OpenFile();
+			}
+
+			return capture.read(frame) && !frame.empty();
+		}
+
+		bool ReplayFrameSource::OpenFile() {
+			if (!capture.open(path)) {
+				return false;
+			}
+			// a format of -1 makes the FFmpeg backend return the demuxed packets as they are
+			compressed = passthrough && capture.set(cv::CAP_PROP_FORMAT, -1);
+			return true;
+		}
+
+		bool ReplayFrameSource::ReadDirectory(Mat& frame) {
+			string file;
+			if (!NextFile(file)) {
+				return false;
+			}
+
+			frame = cv::imread(file, cv::IMREAD_COLOR);
+			return !frame.empty();
+		}
+
+		bool ReplayFrameSource::NextFile(string& file) {
+			if (nextFile >= files.size()) {
+				if (!loop) {
+					isOpened = false;
+					return false;
+				}
+				nextFile = 0;
+			}
+
+			file = files[nextFile++];
+			return true;
+		}
+
+		bool ReplayFrameSource::SetPassthrough(bool enable) {
+			passthrough = enable;
+			return true;
+		}
+
+		bool ReplayFrameSource::IsPassthrough() {
+			return compressed;
+		}
+
+		bool ReplayFrameSource::ReadCompressed(vector<uchar>& jpeg, Poco::Timestamp& captured) {
+			if (!isOpened || !compressed) {
+				return false;
+			}
+
+			if (isDirectory) {
+				string file;
+				if (!NextFile(file)) {
+					return false;
+				}
+				Poco::FileInputStream stream(file);
+				jpeg.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+			}
+			else {
+				Mat packet;
+				if (!ReadFile(packet)) {
+					return false;
+				}
+				const uchar* data = packet.ptr();
+				size_t size = packet.total() * packet.elemSize();
+				if (!JpegStream::IsJpeg(data, size)) {
+					// not Motion JPEG, decode from here on
+					Logger::get("WebcamService").warning("Passthrough disabled, " + path + " is not Motion JPEG, frames are decoded and re-encoded");
+					capture.release();
+					passthrough = false;
+					OpenFile();
+					return false;
+				}
+				jpeg.assign(data, data + size);
+			}
+			captured.update();
+
+			return JpegStream::AddDefaultHuffmanTables(jpeg);
+		}
+
+		double ReplayFrameSource::GetFPS() {
+			return fps;
+		}
+
+		int ReplayFrameSource::GetWidth() {
+			return width;
+		}
+
+		int ReplayFrameSource::GetHeight() {
+			return height;
+		}
+
+		string ReplayFrameSource::GetName() {
+			return (isDirectory ? "directory " : "file ") + path;
+		}
+	}
+}
@@ -0,0 +1,59 @@
+//============================================================================
+// Name        : StageStats.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Timing and drop counters of one pipeline stage
+//============================================================================
+#include "services/webcam/StageStats.h"
+
+#include "Poco\NumberFormatter.h"
+
+namespace services {
+	namespace webcam {
+		StageStats::StageStats(const string& name) : name(name) {
+			stats.frames = 0;
+			stats.dropped = 0;
+			stats.lastMs = 0;
+			stats.averageMs = 0;
+			stats.maxMs = 0;
+		}
+
+		void StageStats::Record(Poco::Int64 elapsedUs) {
+			const double smoothing = 1.0 / 30;
+			double ms = elapsedUs * 0.001;
+
+			Poco::FastMutex::ScopedLock lock(mutex);
+			stats.averageMs = stats.frames == 0 ? ms : stats.averageMs + (ms - stats.averageMs) * smoothing;
+			stats.lastMs = ms;
+			if (ms > stats.maxMs) {
+				stats.maxMs = ms;
+			}
+			++stats.frames;
+		}
+
+		void StageStats::RecordDrop() {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			++stats.dropped;
+		}
+
+		StageStats::Snapshot StageStats::GetSnapshot() {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			return stats;
+		}
+
+		void StageStats::ResetMax() {
+			Poco::FastMutex::ScopedLock lock(mutex);
+			stats.maxMs = 0;
+		}
+
+		const string& StageStats::GetName() const {
+			return name;
+		}
+
+		string StageStats::ToString() {
+			Snapshot s = GetSnapshot();
+			return name + ": " + std::to_string(s.frames) + " frames, avg " + Poco::NumberFormatter::format(s.averageMs, 2) +
+				" ms, max " + Poco::NumberFormatter::format(s.maxMs, 2) + " ms, dropped " + std::to_string(s.dropped);
+		}
+	}
+}
@@ -0,0 +1,243 @@
+//============================================================================
+// Name        : StripedJpegEncoder.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Encodes horizontal stripes of a frame in parallel and joins
+//               them into one baseline JPEG using restart markers
+//============================================================================
+#include "services/webcam/StripedJpegEncoder.h"
+#include "services/webcam/YuvImage.h"
+
+#include "Poco\Logger.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace services {
+	namespace webcam {
+		namespace {
+			const int MIN_STRIPE_ROWS = 64; //smaller stripes cost more in headers and scheduling than they gain
+			const int MCU_ROWS = 16;        //largest MCU height, 4:2:0 subsampling
+			const int MAX_RESTART_INTERVAL = 0xFFFF;
+
+			struct JpegLayout {
+				size_t sofPos;    // SOFn marker
+				size_t sosPos;    // SOS marker, the restart interval is inserted in front of it
+				size_t dataPos;   // first byte of entropy coded data
+				int width;
+				int maxH;         // largest horizontal sampling factor
+				int maxV;         // largest vertical sampling factor
+			};
+
+			// walks the marker segments up to the start of the scan. Accepts sequential
+			// Huffman coded images with a single scan and no restart interval only.
+			bool ParseLayout(const vector<uchar>& jpeg, JpegLayout& layout) {
+				size_t size = jpeg.size();
+				if (size < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8 || jpeg[size - 2] != 0xFF || jpeg[size - 1] != 0xD9) {
+					return false;
+				}
+
+				int components = 0;
+				layout.sofPos = 0;
+				size_t pos = 2;
+				while (pos + 4 <= size) {
+					if (jpeg[pos] != 0xFF) {
+						return false;
+					}
+					uchar marker = jpeg[pos + 1];
+					if (marker == 0xFF) {
+						// fill byte
+						++pos;
+						continue;
+					}
+
+					size_t length = (static_cast<size_t>(jpeg[pos + 2]) << 8) | jpeg[pos + 3];
+					if (length < 2 || pos + 2 + length > size) {
+						return false;
+					}
+
+					if (marker == 0xC0 || marker == 0xC1) {
+						if (length < 8) {
+							return false;
+						}
+						layout.sofPos = pos;
+						layout.width = (jpeg[pos + 7] << 8) | jpeg[pos + 8];
+						components = jpeg[pos + 9];
+						if (length < 8 + 3 * static_cast<size_t>(components)) {
+							return false;
+						}
+						layout.maxH = 1;
+						layout.maxV = 1;
+						for (int i = 0; i < components; i++) {
+							uchar sampling = jpeg[pos + 11 + 3 * i];
+							layout.maxH = std::max(layout.maxH, sampling >> 4);
+							layout.maxV = std::max(layout.maxV, sampling & 0x0F);
+						}
+					}
+					else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+						// progressive, lossless or arithmetic coded
+						return false;
+					}
+					else if (marker == 0xDD) {
+						// restart interval already in use
+						return false;
+					}
+					else if (marker == 0xDA) {
+						// a single interleaved scan over all components
+						if (layout.sofPos == 0 || jpeg[pos + 4] != components) {
+							return false;
+						}
+						layout.sosPos = pos;
+						layout.dataPos = pos + 2 + length;
+						return true;
+					}
+					pos += 2 + length;
+				}
+				return false;
+			}
+		}
+
+		StripedJpegEncoder::StripedJpegEncoder(int stripes, const JpegCompressor::Settings& settings)
+			: stripes(stripes), incompatible(!settings.IsStitchable()), settings(settings) {
+		}
+
+		JpegCompressor& StripedJpegEncoder::GetCompressor(size_t i) {
+			if (compressors.size() <= i) {
+				compressors.resize(i + 1);
+			}
+			if (!compressors[i]) {
+				compressors[i] = new JpegCompressor(settings);
+			}
+			return *compressors[i];
+		}
+
+		int StripedJpegEncoder::GetStripes() const {
+			return stripes > 0 ? stripes : cv::getNumThreads();
+		}
+
+		bool StripedJpegEncoder::Encode(const Mat& image, int quality, vector<uchar>& output) {
+			if (image.type() != CV_8UC3) {
+				return cv::imencode(".jpg", image, output, { cv::IMWRITE_JPEG_QUALITY, quality });
+			}
+
+			StripeEncoder encode = [&](JpegCompressor& compressor, const cv::Range& rows, vector<uchar>& part) {
+				return compressor.Encode(image.rowRange(rows), quality, part);
+			};
+			if (EncodeStripes(image.rows, encode, output)) {
+				return true;
+			}
+			return GetCompressor(0).Encode(image, quality, output);
+		}
+
+		bool StripedJpegEncoder::EncodeYUV(const Mat& yuv, int quality, vector<uchar>& output) {
+			int rows = YuvImage::GetSize(yuv).height;
+			StripeEncoder encode = [&](JpegCompressor& compressor, const cv::Range& range, vector<uchar>& part) {
+				return compressor.EncodeYUV(yuv, range, quality, part);
+			};
+			if (EncodeStripes(rows, encode, output)) {
+				return true;
+			}
+			return GetCompressor(0).EncodeYUV(yuv, cv::Range(0, rows), quality, output);
+		}
+
+		bool StripedJpegEncoder::EncodeStripes(int rows, const StripeEncoder& encode, vector<uchar>& output) {
+			int count = std::min(GetStripes(), rows / MIN_STRIPE_ROWS);
+			if (count < 2 || incompatible) {
+				return false;
+			}
+
+			// every stripe but the last covers the same number of whole MCU rows
+			int stripeHeight = (rows + count - 1) / count;
+			stripeHeight = (stripeHeight + MCU_ROWS - 1) / MCU_ROWS * MCU_ROWS;
+			count = (rows + stripeHeight - 1) / stripeHeight;
+			if (count < 2) {
+				return false;
+			}
+
+			parts.resize(count);
+			// created here, the workers only use them
+			for (int i = 0; i < count; i++) {
+				GetCompressor(i);
+			}
+			std::atomic<bool> failed(false);
+			cv::parallel_for_(cv::Range(0, count), [&](const cv::Range& range) {
+				for (int i = range.start; i < range.end; i++) {
+					if (!encode(*compressors[i], cv::Range(i * stripeHeight, std::min(rows, (i + 1) * stripeHeight)), parts[i])) {
+						failed = true;
+					}
+				}
+			});
+
+			if (!failed && Stitch(parts, rows, stripeHeight, output)) {
+				return true;
+			}
+
+			if (!failed) {
+				// depends on the parameters only, do not waste the stripes on every frame
+				incompatible = true;
+				Poco::Logger::get("WebcamService").warning("JPEG stripes cannot be joined with these encoder parameters, encoding on one thread");
+			}
+			return false;
+		}
+
+		bool StripedJpegEncoder::Stitch(const vector<vector<uchar>>& parts, int height, int stripeHeight, vector<uchar>& output) {
+			if (parts.size() < 2 || height > 0xFFFF) {
+				return false;
+			}
+
+			const vector<uchar>& first = parts[0];
+			JpegLayout layout;
+			if (!ParseLayout(first, layout)) {
+				return false;
+			}
+
+			int mcuWidth = 8 * layout.maxH;
+			int mcuHeight = 8 * layout.maxV;
+			if (stripeHeight % mcuHeight != 0) {
+				return false;
+			}
+			int interval = (layout.width + mcuWidth - 1) / mcuWidth * (stripeHeight / mcuHeight);
+			if (interval > MAX_RESTART_INTERVAL) {
+				return false;
+			}
+
+			// all stripes have to share tables and sampling, only the height in SOF may differ
+			const size_t heightPos = layout.sofPos + 5;
+			size_t total = layout.dataPos + 6 + 2;
+			for (size_t i = 0; i < parts.size(); i++) {
+				const vector<uchar>& part = parts[i];
+				JpegLayout partLayout;
+				if (!ParseLayout(part, partLayout) || partLayout.sosPos != layout.sosPos || partLayout.dataPos != layout.dataPos ||
+					!std::equal(first.begin(), first.begin() + heightPos, part.begin()) ||
+					!std::equal(first.begin() + heightPos + 2, first.begin() + layout.dataPos, part.begin() + heightPos + 2)) {
+					return false;
+				}
+				total += part.size() - layout.dataPos - 2 + 2;
+			}
+
+			output.clear();
+			output.reserve(total);
+			output.insert(output.end(), first.begin(), first.begin() + layout.sosPos);
+			output[heightPos] = static_cast<uchar>(height >> 8);
+			output[heightPos + 1] = static_cast<uchar>(height & 0xFF);
+
+			// DRI in front of the scan
+			const uchar restartInterval[] = { 0xFF, 0xDD, 0x00, 0x04, static_cast<uchar>(interval >> 8), static_cast<uchar>(interval & 0xFF) };
+			output.insert(output.end(), restartInterval, restartInterval + sizeof(restartInterval));
+			output.insert(output.end(), first.begin() + layout.sosPos, first.begin() + layout.dataPos);
+
+			for (size_t i = 0; i < parts.size(); i++) {
+				if (i > 0) {
+					output.push_back(0xFF);
+					output.push_back(static_cast<uchar>(0xD0 + ((i - 1) & 7)));
+				}
+				// entropy coded data is byte aligned at the end of every stripe, EOI is dropped
+				output.insert(output.end(), parts[i].begin() + layout.dataPos, parts[i].end() - 2);
+			}
+
+			output.push_back(0xFF);
+			output.push_back(0xD9);
+			return true;
+		}
+	}
+}
@@ -0,0 +1,166 @@
+//============================================================================
+// Name        : SyntheticFrameSource.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Generates test pattern frames without any capture hardware
+//============================================================================
+#include "services/webcam/SyntheticFrameSource.h"
+
+#include "opencv2\imgproc.hpp"
+#include "Poco\Logger.h"
+#include "Poco\String.h"
+#include "Poco\DateTimeFormatter.h"
+#include "Poco\Timestamp.h"
+
+using Poco::Logger;
+
+namespace services {
+	namespace webcam {
+		SyntheticFrameSource::SyntheticFrameSource(int width, int height, double fps, Pattern pattern)
+			: width(width), height(height), fps(fps), pattern(pattern), isOpened(false), frameCounter(0) {
+		}
+
+		SyntheticFrameSource::~SyntheticFrameSource() {
+			Close();
+		}
+
+		SyntheticFrameSource::Pattern SyntheticFrameSource::ParsePattern(const string& name) {
+			string lower = Poco::toLower(name);
+			if (lower == "checkerboard") {
+				return PATTERN_CHECKERBOARD;
+			}
+			if (lower == "gradient") {
+				return PATTERN_GRADIENT;
+			}
+			return PATTERN_BARS;
+		}
+
+		bool SyntheticFrameSource::Open() {
+			Logger& logger = Logger::get("WebcamService");
+
+			if (width <= 0 || height <= COUNTER_STRIP_HEIGHT || fps <= 0) {
+				logger.error("Invalid synthetic source settings!");
+				return false;
+			}
+
+			RenderBackground();
+			frameCounter = 0;
+			isOpened = true;
+
+			logger.information("Synthetic source: " + std::to_string(width) + "x" + std::to_string(height) + " @ " + std::to_string(fps) + " FPS");
+
+			return true;
+		}
+
+		void SyntheticFrameSource::Close() {
+			isOpened = false;
+			background.release();
+		}
+
+		bool SyntheticFrameSource::IsOpened() {
+			return isOpened;
+		}
+
+		void SyntheticFrameSource::RenderBackground() {
+			background.create(height, width, CV_8UC3);
+
+			switch (pattern) {
+			case PATTERN_CHECKERBOARD: {
+				const int cell = std::max(8, width / 16);
+				for (int y = 0; y < height; y++) {
+					cv::Vec3b* row = background.ptr<cv::Vec3b>(y);
+					for (int x = 0; x < width; x++) {
+						uchar v = ((x / cell + y / cell) % 2) ? 230 : 25;
+						row[x] = cv::Vec3b(v, v, v);
+					}
+				}
+				break;
+			}
+			case PATTERN_GRADIENT:
+				for (int y = 0; y < height; y++) {
+					cv::Vec3b* row = background.ptr<cv::Vec3b>(y);
+					for (int x = 0; x < width; x++) {
+						row[x] = cv::Vec3b(
+							static_cast<uchar>(255 * x / width),
+							static_cast<uchar>(255 * y / height),
+							static_cast<uchar>(255 - 255 * x / width));
+					}
+				}
+				break;
+			case PATTERN_BARS:
+			default: {
+				// SMPTE-like 75% color bars: white, yellow, cyan, green, magenta, red, blue (BGR)
+				static const cv::Scalar bars[] = {
+					cv::Scalar(191, 191, 191), cv::Scalar(0, 191, 191), cv::Scalar(191, 191, 0), cv::Scalar(0, 191, 0),
+					cv::Scalar(191, 0, 191), cv::Scalar(0, 0, 191), cv::Scalar(191, 0, 0)
+				};
+				const int count = sizeof(bars) / sizeof(bars[0]);
+				for (int i = 0; i < count; i++) {
+					int x0 = width * i / count;
+					int x1 = width * (i + 1) / count;
+					cv::rectangle(background, cv::Point(x0, 0), cv::Point(x1 - 1, height - 1), bars[i], cv::FILLED);
+				}
+				break;
+			}
+			}
+		}
+
+		void SyntheticFrameSource::RenderCounterStrip(Mat& frame) {
+			const int bits = 32;
+			const int top = height - COUNTER_STRIP_HEIGHT;
+			for (int i = 0; i < bits; i++) {
+				bool set = ((frameCounter >> (bits - 1 - i)) & 1) != 0;
+				int x0 = width * i / bits;
+				int x1 = width * (i + 1) / bits;
+				cv::rectangle(frame, cv::Point(x0, top), cv::Point(x1 - 1, height - 1), set ? cv::Scalar(255, 255, 255) : cv::Scalar(0, 0, 0), cv::FILLED);
+			}
+		}
+
+		bool SyntheticFrameSource::Read(Mat& frame) {
+			if (!isOpened) {
+				return false;
+			}
+
+			background.copyTo(frame);
+
+			// a box sweeping across the frame makes stalls and judder visible
+			const int box = std::max(16, height / 8);
+			const int travel = std::max(1, width - box);
+			const int period = 2 * travel;
+			int pos = static_cast<int>((frameCounter * std::max(1, width / 64)) % period);
+			int x = pos < travel ? pos : period - pos;
+			int y = (height - COUNTER_STRIP_HEIGHT - box) / 2;
+			cv::rectangle(frame, cv::Rect(x, y, box, box), cv::Scalar(40, 40, 40), cv::FILLED);
+
+			const double scale = std::max(0.5, height / 480.0);
+			const int thickness = std::max(1, static_cast<int>(scale * 2));
+			string counter = "#" + std::to_string(frameCounter);
+			string time = Poco::DateTimeFormatter::format(Poco::Timestamp(), "%H:%M:%S.%i");
+			cv::putText(frame, counter, cv::Point(static_cast<int>(20 * scale), static_cast<int>(50 * scale)), cv::FONT_HERSHEY_SIMPLEX, 1.5 * scale, cv::Scalar(0, 0, 0), thickness * 3);
+			cv::putText(frame, counter, cv::Point(static_cast<int>(20 * scale), static_cast<int>(50 * scale)), cv::FONT_HERSHEY_SIMPLEX, 1.5 * scale, cv::Scalar(255, 255, 255), thickness);
+			cv::putText(frame, time, cv::Point(static_cast<int>(20 * scale), static_cast<int>(100 * scale)), cv::FONT_HERSHEY_SIMPLEX, scale, cv::Scalar(0, 0, 0), thickness * 3);
+			cv::putText(frame, time, cv::Point(static_cast<int>(20 * scale), static_cast<int>(100 * scale)), cv::FONT_HERSHEY_SIMPLEX, scale, cv::Scalar(255, 255, 255), thickness);
+
+			RenderCounterStrip(frame);
+
+			frameCounter++;
+			return true;
+		}
+
+		double SyntheticFrameSource::GetFPS() {
+			return fps;
+		}
+
+		int SyntheticFrameSource::GetWidth() {
+			return width;
+		}
+
+		int SyntheticFrameSource::GetHeight() {
+			return height;
+		}
+
+		string SyntheticFrameSource::GetName() {
+			return "synthetic " + std::to_string(width) + "x" + std::to_string(height);
+		}
+	}
+}
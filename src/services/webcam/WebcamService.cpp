@@ -5,10 +5,13 @@
 // Description :
 //============================================================================
 #include "services/webcam/WebcamService.h"
+#include "services/webcam/CameraFrameSource.h"
+#include "services/webcam/YuvImage.h"
 #include <iostream>
 #include <iomanip>
 
 #include <Poco\Clock.h>
+#include <Poco\NumberFormatter.h>
 
 #include <Poco\Stopwatch.h>
 using Poco::Stopwatch;
@@ -18,13 +21,47 @@ using std::cout;
 
 namespace services {
 	namespace webcam {
-		WebcamService::WebcamService() : capture(VideoCapture()) {
+		namespace {
+			const long DEMAND_WAIT_TIMEOUT = 100; //in ms, bounds the reaction to StopRecording() while suspended
+			const long REOPEN_DELAY = 1000; //in ms between attempts to reopen a released source
+			const double FPS_CAP_TOLERANCE = 0.9; //frames arriving slightly early still count for the fps cap
+			const int MAX_FAILED_READS = 50; //consecutive empty reads before the source counts as lost
+		}
+
+		WebcamService::Output::Output(const Rendition& rendition, int stripes, const JpegCompressor::Settings& settings, int history)
+			: rendition(rendition), viewers(0), heldUntil(0), frames(history), lastCaptured(0), encoder(stripes, settings), lastSize(0) {
+		}
+
+		WebcamService::WebcamService() : WebcamService(new CameraFrameSource(0, 15)) {
+		}
+
+		WebcamService::WebcamService(FrameSource::Ptr source) : WebcamService(source, Config()) {
+		}
+
+		WebcamService::WebcamService(FrameSource::Ptr source, const Config& config)
+			: config(config), pool(new BufferPool(config.pool)), source(source), rawFrames(config.queueSize), captureStats("capture"), encodeStats("encode"), latencyStats("capture to publish"), governor(config.governor), graph(config.stages) {
 			recordingThread = new Thread("WebCamRecording");
 			recordingAdapter = new RunnableAdapter<WebcamService>(*this, &WebcamService::RecordingCore);
+			encodingThread = new Thread("WebCamEncoding");
+			encodingAdapter = new RunnableAdapter<WebcamService>(*this, &WebcamService::EncodingCore);
 			isRecording = false;
-			params = { cv::IMWRITE_JPEG_QUALITY, 100 };
-			fps = 15;
-			delay = 1000 / fps; //in ms
+			viewers = 0;
+			isSuspended = false;
+			published = 0;
+			if (this->config.renditions.empty()) {
+				this->config.renditions.push_back(Rendition());
+			}
+			for (auto& rendition : this->config.renditions) {
+				outputs.push_back(new Output(rendition, config.encodeStripes, config.encoder, config.history));
+			}
+			if (config.passthrough && !source->SetPassthrough(true)) {
+				Logger::get("WebcamService").warning(source->GetName() + " cannot deliver compressed frames, passthrough disabled");
+			}
+			if (config.nativeYUV && !source->SetNativeYUV(true)) {
+				Logger::get("WebcamService").warning(source->GetName() + " cannot deliver YUV frames, frames are converted to BGR");
+			}
+			SetFrameRate(15);
+			AddObserver(&graph);
 		}
 
 		WebcamService::~WebcamService() {
@@ -32,9 +69,15 @@ namespace services {
 				StopRecording();
 			}
 
-			if (capture.isOpened()) {
-				capture.release();
-			}
+			source->Close();
+
+			RemoveObserver(&graph);
+			graph.RemoveAll();
+
+			delete recordingAdapter;
+			delete recordingThread;
+			delete encodingAdapter;
+			delete encodingThread;
 		}
 
 		int WebcamService::GetDelay() {
@@ -45,55 +88,196 @@ namespace services {
 			return fps;
 		}
 
-		void WebcamService::SetModifiedImage(Mat& image) {
-			//Stopwatch sw;
-			//sw.start();
+		StageStats& WebcamService::GetCaptureStats() {
+			return captureStats;
+		}
+
+		StageStats& WebcamService::GetEncodeStats() {
+			return encodeStats;
+		}
+
+		StageStats& WebcamService::GetLatencyStats() {
+			return latencyStats;
+		}
+
+		EncodingGovernor& WebcamService::GetGovernor() {
+			return governor;
+		}
+
+		BufferPool& WebcamService::GetBufferPool() {
+			return *pool;
+		}
+
+		ProcessingGraph& WebcamService::GetProcessingGraph() {
+			return graph;
+		}
+
+		void WebcamService::SetFrameRate(double rate) {
+			fps = std::max(1, static_cast<int>(rate + 0.5));
+			delay = static_cast<int>(1000 / rate); //in ms
+			frameInterval = static_cast<Poco::Clock::ClockDiff>(1000000 / rate);
+		}
+
+		bool WebcamService::SetModifiedImage(int rendition, const CapturedFrame& frame) {
+			Output& output = *outputs[rendition];
+
+			// scale and encode outside of the lock, viewers keep sending the previous frame meanwhile
+			int quality = governor.GetQuality(output.rendition.quality);
+			cv::Size sourceSize = frame.GetSize();
+			cv::Size size = output.rendition.GetSize(sourceSize);
+			bool encoded = true;
+			// the source already encoded it, quality settings and the governor's quality drop do not apply.
+			// Published as is, the viewers share the buffer the source read into
+			bool passthrough = frame.GetCompressed() && sourceSize.area() > 0 && size == sourceSize;
+			if (!passthrough) {
+				// the previous buffer went into the published frame, frames of a rendition hardly change in size
+				pool->Acquire(output.lastSize + output.lastSize / 4, output.buffer);
+				if (!frame.GetYUV().empty()) {
+					// straight from the camera's YUV into the encoder, scaled plane by plane
+					if (size != sourceSize) {
+						YuvImage::Resize(frame.GetYUV(), size, output.scaled);
+						encoded = output.encoder.EncodeYUV(output.scaled, quality, output.buffer);
+					}
+					else {
+						encoded = output.encoder.EncodeYUV(frame.GetYUV(), quality, output.buffer);
+					}
+				}
+				// decoded once per frame and shared with the readers of the latest frame,
+				// whoever needs the pixels first pays for it
+				else if (frame.GetImage().empty()) {
+					encoded = false;
+				}
+				else if (size != frame.GetImage().size()) {
+					cv::resize(frame.GetImage(), output.scaled, size, 0, 0, cv::INTER_AREA);
+					encoded = output.encoder.Encode(output.scaled, quality, output.buffer);
+				}
+				else {
+					// large frames are split into stripes encoded on all cores
+					encoded = output.encoder.Encode(frame.GetImage(), quality, output.buffer);
+				}
+			}
+			if (!encoded) {
+				return false;
+			}
+			output.lastCaptured = frame.GetCaptured();
+			if (!passthrough) {
+				output.lastSize = output.buffer.size();
+			}
 
 			Poco::Mutex::ScopedLock lock(modifiedImgMutex); //will be released after leaving scop
-			// encode mat to jpg and copy it to content
-			cv::imencode(".jpg", image, modifiedImage, params);
+			Poco::UInt64 sequence = output.frames.GetSequence() + 1;
+			output.frames.Add(passthrough ? new EncodedFrame(sequence, frame.GetCompressed()) : new EncodedFrame(sequence, frame.GetCaptured(), output.buffer, pool));
+			++published;
+			modifiedImgAvailable.broadcast();
+			return true;
+		}
+
+		EncodedFrame::Ptr WebcamService::GetModifiedImage() {
+			return GetModifiedImage(0);
+		}
 
-			//sw.stop();
-			//printf("modified image: %f  ms\n", sw.elapsed() * 0.001);
+		EncodedFrame::Ptr WebcamService::GetModifiedImage(Poco::UInt64 sequence, long timeout) {
+			return GetModifiedImage(0, sequence, timeout);
 		}
 
-		vector<uchar>* WebcamService::GetModifiedImage() {
+		EncodedFrame::Ptr WebcamService::GetModifiedImage(int rendition) {
+			Poco::Mutex::ScopedLock lock(modifiedImgMutex); //only guards the reference, the frame itself is immutable
+			return outputs[rendition]->frames.GetLatest();
+		}
+
+		EncodedFrame::Ptr WebcamService::GetModifiedImage(int rendition, Poco::UInt64 sequence, long timeout) {
+			Output& output = *outputs[rendition];
+			Clock start;
 			Poco::Mutex::ScopedLock lock(modifiedImgMutex); //will be released after leaving scop
-			vector<uchar> *tempImg = new vector<uchar>(modifiedImage.begin(), modifiedImage.end());
-			return tempImg;
+			// the condition is shared by all renditions, other ones publishing must not extend the wait
+			while (output.frames.GetSequence() <= sequence) {
+				long remaining = timeout - static_cast<long>(start.elapsed() / 1000);
+				if (remaining <= 0 || !modifiedImgAvailable.tryWait(modifiedImgMutex, remaining)) {
+					return EncodedFrame::Ptr();
+				}
+			}
+			return output.frames.GetLatest();
+		}
+
+		EncodedFrame::Ptr WebcamService::GetFrameAfter(int rendition, Poco::UInt64 sequence, long timeout) {
+			return WaitForFrameAfter(*outputs[rendition], sequence, timeout);
+		}
+
+		EncodedFrame::Ptr WebcamService::GetFrameAfter(int rendition, const Poco::Timestamp& captured, long timeout) {
+			return WaitForFrameAfter(*outputs[rendition], captured, timeout);
+		}
+
+		template<class Position>
+		EncodedFrame::Ptr WebcamService::WaitForFrameAfter(Output& output, const Position& position, long timeout) {
+			Clock start;
+			Poco::Mutex::ScopedLock lock(modifiedImgMutex);
+			EncodedFrame::Ptr frame = output.frames.GetAfter(position);
+			// the condition is shared by all renditions, so a wake up does not imply a frame of this one
+			while (!frame) {
+				long remaining = timeout - static_cast<long>(start.elapsed() / 1000);
+				if (remaining <= 0 || !modifiedImgAvailable.tryWait(modifiedImgMutex, remaining)) {
+					return EncodedFrame::Ptr();
+				}
+				frame = output.frames.GetAfter(position);
+			}
+			return frame;
+		}
+
+		Poco::UInt64 WebcamService::WaitForFrames(Poco::UInt64 published, long timeout) {
+			Poco::Mutex::ScopedLock lock(modifiedImgMutex);
+			if (this->published <= published) {
+				modifiedImgAvailable.tryWait(modifiedImgMutex, timeout);
+			}
+			return this->published;
+		}
+
+		Poco::UInt64 WebcamService::GetFrameSequence() {
+			Poco::Mutex::ScopedLock lock(modifiedImgMutex);
+			return outputs[0]->frames.GetSequence();
+		}
+
+		const vector<Rendition>& WebcamService::GetRenditions() const {
+			return config.renditions;
 		}
 
-		Mat& WebcamService::GetLastImage() {
-			Poco::Mutex::ScopedLock lock(lastImgMutex); //will be released after leaving scop
-			return lastImage;
+		int WebcamService::FindRendition(const string& name) const {
+			for (size_t i = 0; i < config.renditions.size(); i++) {
+				if (config.renditions[i].name == name) {
+					return static_cast<int>(i);
+				}
+			}
+			return -1;
+		}
+
+		CapturedFrame::Ptr WebcamService::GetLatestFrame() {
+			return latestFrame.Get();
 		}
 
 		bool WebcamService::StartRecording() {
 			Logger& logger = Logger::get("WebcamService");
 
-			capture.open(0, cv::CAP_ANY);
-			//capture.open("logger.mp4");
-
-			if (!capture.isOpened()){
-				logger.error("No camera available!");
+			if (!source->IsOpened() && !source->Open()) {
+				logger.error("Frame source not available: " + source->GetName());
 				return false;
 			}
 
-			logger.information("starting recording...");
-
-			//camera settings
-			capture.set(cv::CAP_PROP_FPS, fps);
-			//Possible resolutions : 1280x720, 640x480; 440x330
-			//capture.set(cv::CAP_PROP_FRAME_WIDTH, 640);
-			//capture.set(cv::CAP_PROP_FRAME_HEIGHT, 480);
+			logger.information("starting recording from " + source->GetName() + "...");
+			for (auto& rendition : config.renditions) {
+				string size = rendition.width > 0 || rendition.height > 0 ?
+					"up to " + std::to_string(rendition.width) + "x" + std::to_string(rendition.height) : "source size";
+				string rate = rendition.fps > 0 ? ", up to " + Poco::NumberFormatter::format(rendition.fps, 1) + " fps" : "";
+				logger.information("rendition " + rendition.name + ": " + size + ", quality " + std::to_string(rendition.quality) + rate);
+			}
 
-			logger.information("Camera settings: ");
-			logger.information("FPS: " + std::to_string(capture.get(cv::CAP_PROP_FPS)));
-			logger.information("Resolution: " + std::to_string(capture.get(cv::CAP_PROP_FRAME_WIDTH)) + "x" + std::to_string(capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
-			logger.information("Codec: " + std::to_string(capture.get(cv::CAP_PROP_FOURCC)));
-			logger.information("Format: " + std::to_string(capture.get(cv::CAP_PROP_FORMAT)));
+			double sourceFps = source->GetFPS();
+			if (sourceFps > 0) {
+				SetFrameRate(sourceFps);
+			}
+			governor.Reset(sourceFps > 0 ? sourceFps : fps);
 
 			isRecording = true;
+			rawFrames.Clear();
+			encodingThread->start(*encodingAdapter);
 			recordingThread->start(*recordingAdapter);
 
 			logger.information("started recording");
@@ -110,6 +294,8 @@ namespace services {
 				isRecording = false;
 				logger.information("recording activity stop requested");
 				recordingThread->join();
+				rawFrames.Wake();
+				encodingThread->join();
 				logger.information("recording activity stopped successfully");
 			}
 			else {
@@ -122,49 +308,311 @@ namespace services {
 		}
 
 		bool WebcamService::IsRecording() {
-			return capture.isOpened() && recordingThread->isRunning();
+			// the source is closed while suspended, so only the thread tells whether we are alive
+			return recordingThread->isRunning();
+		}
+
+		bool WebcamService::IsSuspended() {
+			return isSuspended;
+		}
+
+		bool WebcamService::IsPassthrough() {
+			return source->IsPassthrough();
+		}
+
+		bool WebcamService::IsNativeYUV() {
+			return source->IsNativeYUV();
+		}
+
+		void WebcamService::AddViewer(int rendition) {
+			++outputs[rendition]->viewers;
+			++viewers;
+			viewerAdded.set();
+		}
+
+		void WebcamService::RemoveViewer(int rendition) {
+			--outputs[rendition]->viewers;
+			--viewers;
+		}
+
+		void WebcamService::HoldViewer(int rendition, long duration) {
+			Poco::Timestamp::TimeVal until = Poco::Timestamp().epochMicroseconds() + static_cast<Poco::Timestamp::TimeVal>(duration) * 1000;
+			Output& output = *outputs[rendition];
+			Poco::Timestamp::TimeVal current = output.heldUntil;
+			while (current < until && !output.heldUntil.compare_exchange_weak(current, until)) {
+			}
+			viewerAdded.set();
+		}
+
+		bool WebcamService::IsWatched(int rendition) {
+			Output& output = *outputs[rendition];
+			return output.viewers > 0 || output.heldUntil > Poco::Timestamp().epochMicroseconds();
+		}
+
+		bool WebcamService::IsWatched() {
+			if (viewers > 0) {
+				return true;
+			}
+			for (size_t i = 0; i < outputs.size(); i++) {
+				if (IsWatched(static_cast<int>(i))) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		int WebcamService::GetViewerCount() {
+			return viewers;
+		}
+
+		int WebcamService::GetViewerCount(int rendition) {
+			return outputs[rendition]->viewers;
+		}
+
+		bool WebcamService::UpdateDemand(Clock& idleSince) {
+			Logger& logger = Logger::get("WebcamService");
+
+			if (!config.onDemand) {
+				return true;
+			}
+
+			if (IsWatched()) {
+				if (isSuspended) {
+					isSuspended = false;
+					logger.information("viewer connected, resuming encoding");
+				}
+
+				if (!source->IsOpened()) {
+					if (!source->Open()) {
+						logger.error("Frame source not available: " + source->GetName());
+						viewerAdded.tryWait(REOPEN_DELAY);
+						return false;
+					}
+					logger.information("reopened " + source->GetName());
+				}
+				return true;
+			}
+
+			if (!isSuspended) {
+				isSuspended = true;
+				idleSince.update();
+				logger.information("no viewers, encoding suspended");
+			}
+
+			if (source->IsOpened()) {
+				if (config.releaseAfter <= 0 || !idleSince.isElapsed(static_cast<Clock::ClockDiff>(config.releaseAfter) * 1000)) {
+					// keep capturing so a returning viewer gets a fresh frame within one interval
+					return true;
+				}
+				source->Close();
+				logger.information("no viewers for " + std::to_string(config.releaseAfter / 1000) + "s, released " + source->GetName());
+			}
+
+			viewerAdded.tryWait(DEMAND_WAIT_TIMEOUT);
+			return false;
 		}
 
 		void WebcamService::RecordingCore() {
 			Logger& logger = Logger::get("WebcamService");
-			Mat frame;
+			Poco::UInt64 captured = 0;
 
 			//Stopwatch sw;
-			Clock clock;
+			Clock deadline;
+			Clock readStart;
+			Clock idleSince;
 			int newDelay = 0;
+			double frameRate = governor.GetFPS();
+			Poco::Timestamp lastCaptured(0);
+			size_t compressedSize = 0;
+			vector<uchar> jpeg;
+			int failedReads = 0;
+			const bool selfPaced = source->IsSelfPaced();
 
 			while (isRecording) {
-				if (!capture.isOpened()) {
-					logger.error("Lost connection to webcam!");
+				if (governor.GetFPS() != frameRate) {
+					frameRate = governor.GetFPS();
+					SetFrameRate(frameRate);
+				}
+
+				if (!UpdateDemand(idleSince)) {
+					// restart pacing from now once frames are captured again
+					deadline.update();
+					continue;
+				}
+
+				if (!source->IsOpened()) {
+					logger.error("Lost connection to frame source!");
 					break;
 				}
 
-				//Create image frames from capture
-				capture >> frame;
+				if (selfPaced) {
+					// the read blocks until the device delivers, only wait when the governor
+					// wants fewer frames than the camera produces
+					Clock::ClockDiff early = static_cast<Clock::ClockDiff>(frameInterval * FPS_CAP_TOLERANCE) - lastCaptured.elapsed();
+					if (early >= 1000) {
+						Thread::sleep(static_cast<long>(early / 1000));
+					}
+				}
 
-				clock.update();
-				if (!frame.empty()) {
-						{
-							Poco::Mutex::ScopedLock lock(lastImgMutex); //will be released after leaving scop
-							SetModifiedImage(frame);
-						}
+				// a fresh frame per iteration, the previous one may still be queued or encoded
+				RawFrame frame;
+				// pixels, also those decoded later on, come from the pool as long as the source writes into the Mat
+				frame.image.allocator = pool->GetMatAllocator();
+				frame.yuv.allocator = pool->GetMatAllocator();
 
+				//Create image frames from capture
+				readStart.update();
+				bool read;
+				if (source->IsPassthrough()) {
+					pool->Acquire(compressedSize + compressedSize / 4, jpeg);
+					read = source->ReadCompressed(jpeg, frame.captured);
+					if (read) {
+						compressedSize = jpeg.size();
+						frame.compressed = new EncodedFrame(captured + 1, frame.captured, jpeg, pool);
+					}
+				}
+				else if (source->IsNativeYUV()) {
+					read = source->ReadYUV(frame.yuv, frame.captured);
+				}
+				else {
+					read = source->Read(frame.image, frame.captured);
+				}
+				if (read) {
+					failedReads = 0;
+					captureStats.Record(readStart.elapsed());
+					lastCaptured = frame.captured;
+					frame.sequence = ++captured;
+					// compressed and YUV frames are only decoded when a reader or a scaled rendition asks for
+					// the pixels. Both get the same handle, so the frame is decoded at most once
+					CapturedFrame::Ptr shared = new CapturedFrame(frame);
+					latestFrame.Publish(shared);
+
+					// latest frame wins, a slow encoder makes us drop instead of delaying the next grab.
+					// Nothing is encoded while suspended, viewers get the last published frame on connect
+					if (!isSuspended && !rawFrames.Push(shared)) {
+						encodeStats.RecordDrop();
+					}
+
+					// observers only queue the frame, see ProcessingGraph
 					Notify();
 				}
 				else {
 					logger.warning("Captured empty webcam frame!");
+					// an unplugged device may fail every read at once while it still counts as opened
+					if (++failedReads >= MAX_FAILED_READS) {
+						logger.error("Lost connection to frame source!");
+						break;
+					}
+				}
+
+				if (selfPaced) {
+					if (read) {
+						// waiting for the device is not work, only the time since the frame was taken is
+						governor.RecordSlack(frameInterval - lastCaptured.elapsed());
+					}
+					else {
+						// a failed read returns without blocking, wait a frame instead of spinning on it
+						Thread::sleep(delay);
+					}
+					continue;
 				}
 
-				newDelay = static_cast<int>(delay - clock.elapsed() * 0.001);
+				// deadlines advance by a fixed interval so read time does not accumulate drift
+				deadline += frameInterval;
+				Clock::ClockDiff slack = -deadline.elapsed();
+				newDelay = static_cast<int>(slack / 1000);
+				governor.RecordSlack(slack);
 
 				if (newDelay > 0) {
-					//webcam can only be queried after some time again
+					//source can only be queried after some time again
 					//according to the FPS rate
 					Thread::sleep(newDelay);
 				}
+				else if (-newDelay > delay) {
+					// more than one frame behind, resynchronize instead of bursting to catch up
+					deadline.update();
+				}
 			}
 
 			isRecording = false;
 		}
+
+		void WebcamService::EncodingCore() {
+			Clock encodeStart;
+			Clock lastReport;
+			CapturedFrame::Ptr frame;
+
+			while (isRecording) {
+				if (config.statsInterval > 0 && lastReport.isElapsed(static_cast<Clock::ClockDiff>(config.statsInterval) * 1000000)) {
+					LogStats();
+					lastReport.update();
+				}
+
+				StageStats::Snapshot encodeTimes = encodeStats.GetSnapshot();
+				if (governor.Update(encodeTimes.averageMs, encodeTimes.frames)) {
+					Logger::get("WebcamService").information(governor.ToString());
+				}
+
+				if (!rawFrames.Pop(frame, 100)) {
+					continue;
+				}
+
+				// each watched rendition is encoded once per frame, all its viewers share the result
+				encodeStart.update();
+				bool encoded = false;
+				for (size_t i = 0; i < outputs.size(); i++) {
+					if (!IsEncodingDue(static_cast<int>(i), frame->GetCaptured())) {
+						continue;
+					}
+					if (!SetModifiedImage(static_cast<int>(i), *frame)) {
+						Logger::get("WebcamService").warning("Cannot encode frame " + std::to_string(frame->GetSequence()) +
+							" in rendition " + outputs[i]->rendition.name);
+						// a frame without pixels fails for every rendition, an encoder only for its own.
+						// YUV is checked first, GetImage() would convert it
+						if (frame->GetYUV().empty() && frame->GetImage().empty()) {
+							break;
+						}
+						continue;
+					}
+					encoded = true;
+				}
+				if (encoded) {
+					encodeStats.Record(encodeStart.elapsed());
+					latencyStats.Record(frame->GetCaptured().elapsed());
+				}
+				frame.reset();
+			}
+		}
+
+		bool WebcamService::IsEncodingDue(int rendition, const Poco::Timestamp& captured) {
+			Output& output = *outputs[rendition];
+
+			// without on demand mode the default rendition is always kept up to date
+			if (!IsWatched(rendition) && (config.onDemand || rendition != 0)) {
+				return false;
+			}
+
+			if (output.rendition.fps > 0) {
+				Poco::Timestamp::TimeDiff interval = static_cast<Poco::Timestamp::TimeDiff>(1000000 / output.rendition.fps * FPS_CAP_TOLERANCE);
+				if (captured - output.lastCaptured < interval) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void WebcamService::LogStats() {
+			Logger& logger = Logger::get("WebcamService");
+			logger.information(captureStats.ToString() + "; " + encodeStats.ToString() + "; " + latencyStats.ToString() + "; " + governor.ToString() + "; " + pool->ToString());
+			captureStats.ResetMax();
+			encodeStats.ResetMax();
+			latencyStats.ResetMax();
+
+			string stages = graph.ToString();
+			if (!stages.empty()) {
+				logger.information(stages);
+				graph.ResetMax();
+			}
+		}
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,150 @@
+//============================================================================
+// Name        : YuvImage.cpp
+// Author      : ITM13
+// Version     : 1.0
+// Description : Planar YCbCr 4:2:0 frames in the I420 layout of OpenCV
+//============================================================================
+#include "services/webcam/YuvImage.h"
+
+#include "opencv2\imgproc.hpp"
+#include "opencv2\core\hal\intrin.hpp"
+
+#include <cstring>
+
+namespace services {
+	namespace webcam {
+		namespace {
+			const int MIN_PARALLEL_ROWS = 64; //repacking smaller frames is not worth a thread
+
+#if CV_SIMD128
+			// rounded average of two rows of chroma samples
+			inline cv::v_uint8x16 Average(const cv::v_uint8x16& a, const cv::v_uint8x16& b) {
+				cv::v_uint16x8 a0, a1, b0, b1;
+				cv::v_expand(a, a0, a1);
+				cv::v_expand(b, b0, b1);
+				return cv::v_rshr_pack<1>(a0 + b0, a1 + b1);
+			}
+#endif
+
+			// Y plane, Cb and Cr plane of an allocated I420 Mat as separate headers
+			void GetPlanes(Mat& yuv, int width, int height, Mat& y, Mat& u, Mat& v) {
+				uchar* data = yuv.ptr();
+				size_t chroma = static_cast<size_t>(width / 2) * (height / 2);
+				y = Mat(height, width, CV_8UC1, data);
+				u = Mat(height / 2, width / 2, CV_8UC1, data + static_cast<size_t>(width) * height);
+				v = Mat(height / 2, width / 2, CV_8UC1, data + static_cast<size_t>(width) * height + chroma);
+			}
+		}
+
+		cv::Size YuvImage::GetSize(const Mat& yuv) {
+			return cv::Size(yuv.cols, yuv.rows * 2 / 3);
+		}
+
+		bool YuvImage::IsValid(const Mat& yuv) {
+			return !yuv.empty() && yuv.type() == CV_8UC1 && yuv.isContinuous() && yuv.cols % 2 == 0 && yuv.rows % 3 == 0;
+		}
+
+		const uchar* YuvImage::GetY(const Mat& yuv) {
+			return yuv.ptr();
+		}
+
+		const uchar* YuvImage::GetU(const Mat& yuv) {
+			cv::Size size = GetSize(yuv);
+			return yuv.ptr() + static_cast<size_t>(size.width) * size.height;
+		}
+
+		const uchar* YuvImage::GetV(const Mat& yuv) {
+			cv::Size size = GetSize(yuv);
+			return GetU(yuv) + static_cast<size_t>(size.width / 2) * (size.height / 2);
+		}
+
+		bool YuvImage::FromYUYV(const uchar* data, int width, int height, size_t step, Mat& yuv) {
+			if (width <= 0 || height <= 0 || width % 2 != 0 || height % 2 != 0) {
+				return false;
+			}
+			yuv.create(height * 3 / 2, width, CV_8UC1);
+			uchar* yPlane = yuv.ptr();
+			uchar* uPlane = yPlane + static_cast<size_t>(width) * height;
+			uchar* vPlane = uPlane + static_cast<size_t>(width / 2) * (height / 2);
+
+			// one chroma row per pair of source rows
+			cv::Range pairs(0, height / 2);
+			cv::parallel_for_(pairs, [&](const cv::Range& range) {
+				for (int r = range.start; r < range.end; r++) {
+					const uchar* src0 = data + step * (2 * r);
+					const uchar* src1 = src0 + step;
+					uchar* y0 = yPlane + static_cast<size_t>(width) * (2 * r);
+					uchar* y1 = y0 + width;
+					uchar* u = uPlane + static_cast<size_t>(width / 2) * r;
+					uchar* v = vPlane + static_cast<size_t>(width / 2) * r;
+
+					int x = 0;
+#if CV_SIMD128
+					// 32 pixels per iteration, Y0 U Y1 V groups split into four vectors
+					for (; x <= width - 32; x += 32) {
+						cv::v_uint8x16 even0, u0, odd0, v0, even1, u1, odd1, v1;
+						cv::v_load_deinterleave(src0 + 2 * x, even0, u0, odd0, v0);
+						cv::v_load_deinterleave(src1 + 2 * x, even1, u1, odd1, v1);
+						cv::v_store_interleave(y0 + x, even0, odd0);
+						cv::v_store_interleave(y1 + x, even1, odd1);
+						cv::v_store(u + x / 2, Average(u0, u1));
+						cv::v_store(v + x / 2, Average(v0, v1));
+					}
+#endif
+					for (; x < width; x += 2) {
+						const uchar* p0 = src0 + 2 * x;
+						const uchar* p1 = src1 + 2 * x;
+						y0[x] = p0[0];
+						y0[x + 1] = p0[2];
+						y1[x] = p1[0];
+						y1[x + 1] = p1[2];
+						u[x / 2] = static_cast<uchar>((p0[1] + p1[1] + 1) >> 1);
+						v[x / 2] = static_cast<uchar>((p0[3] + p1[3] + 1) >> 1);
+					}
+				}
+			}, height >= MIN_PARALLEL_ROWS ? -1 : 1);
+			return true;
+		}
+
+		bool YuvImage::FromNV12(const uchar* data, int width, int height, Mat& yuv) {
+			if (width <= 0 || height <= 0 || width % 2 != 0 || height % 2 != 0) {
+				return false;
+			}
+			yuv.create(height * 3 / 2, width, CV_8UC1);
+			size_t luma = static_cast<size_t>(width) * height;
+			size_t chroma = luma / 4;
+			std::memcpy(yuv.ptr(), data, luma);
+
+			const uchar* uv = data + luma;
+			uchar* u = yuv.ptr() + luma;
+			uchar* v = u + chroma;
+			size_t i = 0;
+#if CV_SIMD128
+			for (; i + 16 <= chroma; i += 16) {
+				cv::v_uint8x16 cb, cr;
+				cv::v_load_deinterleave(uv + 2 * i, cb, cr);
+				cv::v_store(u + i, cb);
+				cv::v_store(v + i, cr);
+			}
+#endif
+			for (; i < chroma; i++) {
+				u[i] = uv[2 * i];
+				v[i] = uv[2 * i + 1];
+			}
+			return true;
+		}
+
+		void YuvImage::Resize(const Mat& src, const cv::Size& size, Mat& dst) {
+			cv::Size srcSize = GetSize(src);
+			dst.create(size.height * 3 / 2, size.width, CV_8UC1);
+
+			Mat srcY, srcU, srcV, dstY, dstU, dstV;
+			GetPlanes(const_cast<Mat&>(src), srcSize.width, srcSize.height, srcY, srcU, srcV);
+			GetPlanes(dst, size.width, size.height, dstY, dstU, dstV);
+			// the headers already have the target size, resize writes into dst
+			cv::resize(srcY, dstY, dstY.size(), 0, 0, cv::INTER_AREA);
+			cv::resize(srcU, dstU, dstU.size(), 0, 0, cv::INTER_AREA);
+			cv::resize(srcV, dstV, dstV.size(), 0, 0, cv::INTER_AREA);
+		}
+	}
+}